@@ -0,0 +1,180 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+/// <summary>
+/// Measurements of a single sort call, as returned by heap_sorter::report().
+/// </summary>
+struct sort_report
+{
+	long long comparisons = 0;
+	long long swaps = 0;
+
+	/// <summary>
+	/// Single element moves, used instead of swaps by the bottom-up sift.
+	/// </summary>
+	long long moves = 0;
+
+	/// <summary>
+	/// sift_depth_histogram[d] counts the sift-down calls that descended exactly d levels.
+	/// 64 buckets are enough for any heap addressable with 64 bit indices.
+	/// </summary>
+	std::array<long long, 64> sift_depth_histogram{};
+
+	/// <summary>
+	/// Descents that most likely missed the cache, see counting_instrumentation::on_descend.
+	/// </summary>
+	long long estimated_cache_misses = 0;
+};
+
+/// <summary>
+/// Instrumentation policy that records nothing. All hooks are empty constexpr
+/// functions, so a sorter using it compiles to the bare algorithm.
+/// It also documents the hook interface every policy provides: on_swap and on_move
+/// are called after the elements were exchanged / moved, with indices relative to
+/// the begin of the heap.
+/// </summary>
+struct null_instrumentation
+{
+	constexpr void reset() noexcept {}
+	constexpr void on_compare(std::ptrdiff_t, std::ptrdiff_t) noexcept {}
+	constexpr void on_swap(std::ptrdiff_t, std::ptrdiff_t) noexcept {}
+	constexpr void on_move(std::ptrdiff_t, std::ptrdiff_t) noexcept {}
+	constexpr void on_descend(std::ptrdiff_t, std::ptrdiff_t, std::size_t) noexcept {}
+	constexpr void on_sift(std::size_t) noexcept {}
+	constexpr void merge(const null_instrumentation &) noexcept {}
+
+	constexpr sort_report report() const noexcept { return {}; }
+};
+
+/// <summary>
+/// Instrumentation policy that counts operations of the current sort call.
+/// The counters live inside the policy object and therefore inside the sorter,
+/// so sorters running on different threads never share (or race on) counters.
+/// </summary>
+class counting_instrumentation
+{
+public:
+	/// <summary>
+	/// Bytes per cache line assumed by the cache model.
+	/// </summary>
+	static constexpr std::size_t cache_line_bytes = 64;
+
+	/// <summary>
+	/// Bytes at the front of the heap that are assumed to stay cached (L1 sized).
+	/// </summary>
+	static constexpr std::size_t cached_bytes = 32 * 1024;
+
+	constexpr void reset() noexcept { report_ = {}; }
+
+	constexpr void on_compare(std::ptrdiff_t, std::ptrdiff_t) noexcept { report_.comparisons++; }
+
+	constexpr void on_swap(std::ptrdiff_t, std::ptrdiff_t) noexcept { report_.swaps++; }
+
+	constexpr void on_move(std::ptrdiff_t, std::ptrdiff_t) noexcept { report_.moves++; }
+
+	/// <summary>
+	/// Called whenever a sift moves from a parent to one of its children.
+	/// The upper levels of the heap are hot, so only descents landing outside
+	/// the first cached_bytes and on a different cache line count as misses.
+	/// </summary>
+	constexpr void on_descend(std::ptrdiff_t from, std::ptrdiff_t to, std::size_t element_size) noexcept
+	{
+		auto const from_byte = static_cast<std::size_t>(from) * element_size;
+		auto const to_byte = static_cast<std::size_t>(to) * element_size;
+		if (to_byte >= cached_bytes && to_byte / cache_line_bytes != from_byte / cache_line_bytes)
+		{
+			report_.estimated_cache_misses++;
+		}
+	}
+
+	constexpr void on_sift(std::size_t depth) noexcept
+	{
+		auto const bucket = depth < report_.sift_depth_histogram.size() ? depth : report_.sift_depth_histogram.size() - 1;
+		report_.sift_depth_histogram[bucket]++;
+	}
+
+	/// <summary>
+	/// Add the counts of another instance, e.g. of a worker thread of a parallel heap build.
+	/// </summary>
+	constexpr void merge(const counting_instrumentation &other) noexcept
+	{
+		report_.comparisons += other.report_.comparisons;
+		report_.swaps += other.report_.swaps;
+		report_.moves += other.report_.moves;
+		report_.estimated_cache_misses += other.report_.estimated_cache_misses;
+		for (std::size_t d = 0; d < report_.sift_depth_histogram.size(); ++d)
+		{
+			report_.sift_depth_histogram[d] += other.report_.sift_depth_histogram[d];
+		}
+	}
+
+	constexpr sort_report report() const noexcept { return report_; }
+
+private:
+	sort_report report_;
+};
+
+/// <summary>
+/// Instrumentation policy that counts like counting_instrumentation and additionally
+/// records every compare, swap and move in order. Meant for debugging and visualizing
+/// small inputs; the trace grows with every operation.
+/// </summary>
+class trace_instrumentation : public counting_instrumentation
+{
+public:
+	enum class event_kind
+	{
+		compare,
+		swap,
+		move
+	};
+
+	struct event
+	{
+		event_kind kind;
+		std::ptrdiff_t i;
+		std::ptrdiff_t j;
+	};
+
+	void reset()
+	{
+		counting_instrumentation::reset();
+		events_.clear();
+	}
+
+	void on_compare(std::ptrdiff_t i, std::ptrdiff_t j)
+	{
+		counting_instrumentation::on_compare(i, j);
+		events_.push_back({event_kind::compare, i, j});
+	}
+
+	void on_swap(std::ptrdiff_t i, std::ptrdiff_t j)
+	{
+		counting_instrumentation::on_swap(i, j);
+		events_.push_back({event_kind::swap, i, j});
+	}
+
+	void on_move(std::ptrdiff_t from, std::ptrdiff_t to)
+	{
+		counting_instrumentation::on_move(from, to);
+		events_.push_back({event_kind::move, from, to});
+	}
+
+	/// <summary>
+	/// Add the counts and append the events of another instance.
+	/// Events of parallel workers therefore appear grouped by worker, not interleaved.
+	/// </summary>
+	void merge(const trace_instrumentation &other)
+	{
+		counting_instrumentation::merge(other);
+		events_.insert(events_.end(), other.events_.begin(), other.events_.end());
+	}
+
+	const std::vector<event> &events() const noexcept { return events_; }
+
+private:
+	std::vector<event> events_;
+};
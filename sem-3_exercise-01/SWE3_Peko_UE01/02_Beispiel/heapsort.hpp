@@ -1,41 +1,516 @@
 #pragma once
 
-#include <vector>
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <future>
 #include <iostream>
-#include <string>
+#include <iterator>
+#include <ranges>
+#include <utility>
+#include <vector>
 
-extern long long count_cmp;
-extern long long count_swap;
+#include "heap_instrumentation.hpp"
+#include "thread_pool.hpp"
 
+/// <summary>
+/// How a sift-down restores the heap property below a node.
+/// </summary>
+enum class sift_strategy
+{
+	/// <summary>
+	/// Classic sift: compare the largest child with the sifted element on every
+	/// level and stop as soon as the element is in place (d comparisons per level).
+	/// </summary>
+	top_down,
+
+	/// <summary>
+	/// Floyd's bottom-up sift: descend along the largest children down to a leaf
+	/// (d - 1 comparisons per level), then climb back up to the element's final
+	/// position. Sifted elements usually belong near the bottom, so this saves
+	/// about one comparison per level and replaces swaps by moves.
+	/// </summary>
+	bottom_up
+};
+
+/// <summary>
+/// Arity for which one group of siblings of T spans a single 64 byte cache line,
+/// e.g. 8 for 64 bit keys or 16 for ints (but at least 2).
+/// </summary>
+template <typename T>
+inline constexpr std::size_t cache_line_arity = sizeof(T) >= 32 ? 2 : 64 / sizeof(T);
+
+/// <summary>
+/// In-place heapsort over a random access range.
+/// Elements are ordered by cmp(proj(a), proj(b)); the comparator and the projection
+/// are stored by value and invoked directly, so they get inlined like in std::sort.
+/// No memory is allocated, all operations are constexpr.
+///
+/// The heap is stored implicitly with Arity children per node: the children of
+/// node i are Arity * i + 1 ... Arity * i + Arity. The siblings of a node are
+/// adjacent in memory, so with cache_line_arity a whole sibling group is fetched
+/// with at most two cache lines while the tree is only log_Arity(n) levels deep.
+///
+/// The overloads taking a thread_pool build the heap in parallel; they allocate
+/// a little bookkeeping and are not constexpr.
+/// </summary>
+/// <typeparam name="RandomIt">random access iterator of the sorted range</typeparam>
+/// <typeparam name="Compare">strict weak ordering on the projected values</typeparam>
+/// <typeparam name="Projection">maps an element to the value it is compared by</typeparam>
+/// <typeparam name="Instrumentation">instrumentation policy, see heap_instrumentation.hpp</typeparam>
+/// <typeparam name="Arity">number of children per heap node</typeparam>
+/// <typeparam name="Sift">sift-down variant, see sift_strategy</typeparam>
+template <
+	std::random_access_iterator RandomIt,
+	typename Compare = std::ranges::less,
+	typename Projection = std::identity,
+	typename Instrumentation = null_instrumentation,
+	std::size_t Arity = 2,
+	sift_strategy Sift = sift_strategy::top_down>
+	requires std::sortable<RandomIt, Compare, Projection>
 class heap_sorter
 {
+	static_assert(Arity >= 2, "a heap needs at least two children per node");
+
 public:
-	using content_t = std::vector<int>;
-	using index_t = content_t::size_type;
-	using size_t = content_t::size_type;
-	using value_t = content_t::value_type;
+	using iterator_t = RandomIt;
+	using value_t = std::iter_value_t<RandomIt>;
+	using index_t = std::iter_difference_t<RandomIt>;
+
+	static constexpr std::size_t arity = Arity;
+	static constexpr sift_strategy sift = Sift;
 
-	static void sort(content_t &c);
-	static void print_content(const content_t &c);
-	static void print_as_tree(const content_t &c);
+	/// <summary>
+	/// Below this many elements the parallel overloads fall back to the serial algorithm,
+	/// as handing out tasks costs more than heapifying a few cache lines.
+	/// </summary>
+	static constexpr index_t parallel_threshold = index_t{1} << 16;
+
+	constexpr heap_sorter() = default;
+
+	constexpr explicit heap_sorter(Compare cmp, Projection proj = {}, Instrumentation instrumentation = {})
+		: cmp_(std::move(cmp)), proj_(std::move(proj)), instrumentation_(std::move(instrumentation)) {}
+
+	/// <summary>
+	/// Sort [first, last) in ascending order.
+	/// Resets the instrumentation, so report() afterwards describes exactly this call.
+	/// </summary>
+	constexpr void sort(RandomIt first, RandomIt last)
+	{
+		instrumentation_.reset();
+		index_t const len = last - first;
+		build_heap(first, len);
+		sort_heap(first, len);
+	}
+
+	/// <summary>
+	/// Sort [first, last) in ascending order, building the initial heap with the pool.
+	/// The sort-down phase is inherently sequential and runs on the calling thread.
+	/// </summary>
+	void sort(RandomIt first, RandomIt last, thread_pool &pool)
+	{
+		instrumentation_.reset();
+		index_t const len = last - first;
+		build_heap(first, len, pool);
+		sort_heap(first, len);
+	}
+
+	/// <summary>
+	/// Rearrange [first, last) so that [first, middle) holds the middle - first smallest
+	/// elements in ascending order; the order of [middle, last) is unspecified.
+	/// Keeps a heap of size k = middle - first and only sifts for elements that beat
+	/// its maximum, so this needs O(n log k) time and no extra memory.
+	/// </summary>
+	constexpr void partial_sort(RandomIt first, RandomIt middle, RandomIt last)
+	{
+		instrumentation_.reset();
+		index_t const k = middle - first;
+		if (k == 0)
+		{
+			return;
+		}
+		build_heap(first, k);
+		for (index_t i = k; i < last - first; ++i)
+		{
+			if (less(first, i, 0))
+			{
+				swap(first, 0, i);
+				shift_down(first, 0, k);
+			}
+		}
+		sort_heap(first, k);
+	}
+
+	/// <summary>
+	/// Rearrange [first, last) into a max-heap (with respect to cmp and proj).
+	/// </summary>
+	constexpr void make_heap(RandomIt first, RandomIt last)
+	{
+		instrumentation_.reset();
+		build_heap(first, last - first);
+	}
+
+	/// <summary>
+	/// Rearrange [first, last) into a max-heap, heapifying independent subtrees
+	/// of the lower levels concurrently on the pool.
+	/// </summary>
+	void make_heap(RandomIt first, RandomIt last, thread_pool &pool)
+	{
+		instrumentation_.reset();
+		build_heap(first, last - first, pool);
+	}
+
+	/// <summary>
+	/// Restore the heap below start, assuming only first[start] may violate it.
+	/// Building block for heap based containers (see top_k); unlike the operations
+	/// above it does not reset the instrumentation, so counts accumulate.
+	/// </summary>
+	/// <param name="first">begin of the heap</param>
+	/// <param name="start">index of the element to sift down</param>
+	/// <param name="len">number of elements in the heap</param>
+	constexpr void shift_down(RandomIt first, index_t start, index_t len)
+	{
+		if constexpr (Sift == sift_strategy::bottom_up)
+		{
+			shift_down_bottom_up(first, start, len);
+		}
+		else
+		{
+			shift_down_top_down(first, start, len);
+		}
+	}
+
+	/// <summary>
+	/// Restore the heap above pos, assuming only first[pos] may violate it
+	/// (e.g. after appending an element). Does not reset the instrumentation.
+	/// </summary>
+	/// <param name="first">begin of the heap</param>
+	/// <param name="pos">index of the element to sift up</param>
+	constexpr void shift_up(RandomIt first, index_t pos)
+	{
+		while (pos > 0)
+		{
+			index_t const p = parent(pos);
+			if (!less(first, p, pos))
+			{
+				break;
+			}
+			swap(first, p, pos);
+			pos = p;
+		}
+	}
+
+	/// <summary>
+	/// Measurements of the last sort call (all zero for null_instrumentation).
+	/// </summary>
+	constexpr sort_report report() const { return instrumentation_.report(); }
+
+	constexpr Instrumentation const &instrumentation() const noexcept { return instrumentation_; }
 
 private:
-	static void build_heap(content_t &c);
-	static void shift_down(content_t &c, index_t start, size_t len);
-	static void print_as_tree(
-		const content_t &c,
-		const index_t i,
-		const size_t len,
-		const size_t depth,
-		std::ostream &out = std::cout);
+	/// <summary>
+	/// Deep enough for any heap: a binary heap of 2^63 elements has 63 levels.
+	/// </summary>
+	static constexpr std::size_t max_depth = 64;
+
+	static constexpr index_t first_child(index_t i) { return (i * static_cast<index_t>(Arity)) + 1; }
+	static constexpr index_t parent(index_t i) { return (i - 1) / static_cast<index_t>(Arity); }
+
+	constexpr void build_heap(RandomIt first, index_t len)
+	{
+		if (len < 2)
+		{
+			return;
+		}
+		// Start from the last parent node and move upwards
+		for (index_t i = parent(len - 1) + 1; i-- > 0;)
+		{
+			shift_down(first, i, len);
+		}
+	}
+
+	void build_heap(RandomIt first, index_t len, thread_pool &pool)
+	{
+		index_t const threads = static_cast<index_t>(pool.size());
+		if (len < parallel_threshold || threads < 2)
+		{
+			build_heap(first, len);
+			return;
+		}
+
+		// Descend to the first level with a few subtrees per thread, so uneven
+		// subtrees (the last level is only partially filled) still balance out
+		index_t level_begin = 0;
+		index_t level_size = 1;
+		while (level_size < threads * 4 && first_child(level_begin) < len)
+		{
+			level_begin = first_child(level_begin);
+			level_size *= static_cast<index_t>(Arity);
+		}
+		index_t const level_end = std::min(level_begin + level_size, len);
+
+		// The subtrees below that level are disjoint, every task heapifies a block of them
+		index_t const tasks = std::min(threads, level_end - level_begin);
+		std::vector<Instrumentation> partial(static_cast<std::size_t>(tasks));
+		std::vector<std::future<void>> pending;
+		pending.reserve(static_cast<std::size_t>(tasks));
+		for (index_t t = 0; t < tasks; ++t)
+		{
+			index_t const roots_begin = level_begin + (level_end - level_begin) * t / tasks;
+			index_t const roots_end = level_begin + (level_end - level_begin) * (t + 1) / tasks;
+			Instrumentation &result = partial[static_cast<std::size_t>(t)];
+			pending.push_back(pool.submit([this, first, roots_begin, roots_end, len, &result]
+			{
+				// A copy of this sorter's policy keeps its state (e.g. pointers of a position tracker); it was
+				// just reset by the caller, so merging the workers' results back does not count anything twice
+				heap_sorter worker(cmp_, proj_, instrumentation_);
+				worker.build_subtrees(first, roots_begin, roots_end, len);
+				result = std::move(worker.instrumentation_);
+			}));
+		}
+		// Wait for all workers before get() rethrows a failed one, the others still use partial
+		for (auto &task : pending)
+		{
+			task.wait();
+		}
+		for (auto &task : pending)
+		{
+			task.get();
+		}
+		for (const auto &result : partial)
+		{
+			instrumentation_.merge(result);
+		}
 
-	static bool less(const content_t &c, index_t i, index_t j) {
-		count_cmp++;
-		return c[i] < c[j];
+		// The few levels above are heapified serially on top of the finished subtrees
+		for (index_t i = level_begin; i-- > 0;)
+		{
+			shift_down(first, i, len);
+		}
 	}
 
-	static void swap(content_t &c, index_t i, index_t j) {
-		count_swap++;
-		std::swap(c[i], c[j]);
+	/// <summary>
+	/// Heapify the subtrees rooted at [roots_begin, roots_end), which all lie on one level.
+	/// The descendants of a contiguous block of nodes are contiguous on every level,
+	/// so the subtrees are processed level by level from the bottom.
+	/// </summary>
+	constexpr void build_subtrees(RandomIt first, index_t roots_begin, index_t roots_end, index_t len)
+	{
+		index_t begin[max_depth] = {roots_begin};
+		index_t end[max_depth] = {roots_end};
+		std::size_t levels = 1;
+		while (first_child(begin[levels - 1]) < len)
+		{
+			begin[levels] = first_child(begin[levels - 1]);
+			end[levels] = std::min(first_child(end[levels - 1]), len);
+			levels++;
+		}
+
+		for (std::size_t level = levels; level-- > 0;)
+		{
+			for (index_t i = end[level]; i-- > begin[level];)
+			{
+				if (first_child(i) < len)
+				{
+					shift_down(first, i, len);
+				}
+			}
+		}
+	}
+
+	constexpr void sort_heap(RandomIt first, index_t len)
+	{
+		for (index_t i = len; i-- > 1;)
+		{
+			// Move the current maximum behind the heap and repair the shrunk heap
+			swap(first, 0, i);
+			shift_down(first, 0, i);
+		}
+	}
+
+	constexpr void shift_down_top_down(RandomIt first, index_t start, index_t len)
+	{
+		index_t i = start;
+		std::size_t depth = 0;
+		while (first_child(i) < len)
+		{
+			index_t largest = largest_child(first, i, len);
+			if (!less(first, i, largest))
+			{
+				break;
+			}
+			swap(first, i, largest);
+			instrumentation_.on_descend(i, largest, sizeof(value_t));
+			i = largest;
+			depth++;
+		}
+		instrumentation_.on_sift(depth);
+	}
+
+	constexpr void shift_down_bottom_up(RandomIt first, index_t start, index_t len)
+	{
+		// Descend to a leaf, remembering the path of largest children
+		index_t path[max_depth] = {start};
+		std::size_t depth = 0;
+		while (first_child(path[depth]) < len)
+		{
+			index_t largest = largest_child(first, path[depth], len);
+			instrumentation_.on_descend(path[depth], largest, sizeof(value_t));
+			path[++depth] = largest;
+		}
+		instrumentation_.on_sift(depth);
+
+		// Climb back up until the sifted element is not smaller than the path element
+		std::size_t target = depth;
+		while (target > 0 && less(first, path[target], start))
+		{
+			target--;
+		}
+		if (target == 0)
+		{
+			return;
+		}
+
+		// Rotate: the path elements move up one level, the sifted element takes their place
+		value_t sifted = std::ranges::iter_move(first + start);
+		for (std::size_t level = 1; level <= target; ++level)
+		{
+			move(first, path[level], path[level - 1]);
+		}
+		first[path[target]] = std::move(sifted);
+		instrumentation_.on_move(start, path[target]);
+	}
+
+	/// <summary>
+	/// Index of the largest child of i, which must have at least one child (Arity - 1 comparisons at most).
+	/// </summary>
+	constexpr index_t largest_child(RandomIt first, index_t i, index_t len)
+	{
+		index_t const begin = first_child(i);
+		index_t const end = len - begin > static_cast<index_t>(Arity) ? begin + static_cast<index_t>(Arity) : len;
+		index_t largest = begin;
+		for (index_t c = begin + 1; c < end; ++c)
+		{
+			if (less(first, largest, c))
+			{
+				largest = c;
+			}
+		}
+		return largest;
+	}
+
+	constexpr bool less(RandomIt first, index_t i, index_t j)
+	{
+		instrumentation_.on_compare(i, j);
+		return std::invoke(cmp_, std::invoke(proj_, first[i]), std::invoke(proj_, first[j]));
+	}
+
+	constexpr void swap(RandomIt first, index_t i, index_t j)
+	{
+		std::ranges::iter_swap(first + i, first + j);
+		instrumentation_.on_swap(i, j);
+	}
+
+	constexpr void move(RandomIt first, index_t from, index_t to)
+	{
+		first[to] = std::ranges::iter_move(first + from);
+		instrumentation_.on_move(from, to);
 	}
+
+	[[no_unique_address]] Compare cmp_{};
+	[[no_unique_address]] Projection proj_{};
+	[[no_unique_address]] Instrumentation instrumentation_{};
 };
+
+/// <summary>
+/// Sort [first, last) with heapsort, without any instrumentation.
+/// </summary>
+template <
+	std::random_access_iterator RandomIt,
+	typename Compare = std::ranges::less,
+	typename Projection = std::identity>
+	requires std::sortable<RandomIt, Compare, Projection>
+constexpr void heap_sort(RandomIt first, RandomIt last, Compare cmp = {}, Projection proj = {})
+{
+	heap_sorter<RandomIt, Compare, Projection>(std::move(cmp), std::move(proj)).sort(first, last);
+}
+
+/// <summary>
+/// Sort a whole random access range (vector, array, span, ...) with heapsort.
+/// </summary>
+template <
+	std::ranges::random_access_range Range,
+	typename Compare = std::ranges::less,
+	typename Projection = std::identity>
+	requires std::sortable<std::ranges::iterator_t<Range>, Compare, Projection>
+constexpr void heap_sort(Range &&range, Compare cmp = {}, Projection proj = {})
+{
+	auto first = std::ranges::begin(range);
+	heap_sort(first, std::ranges::next(first, std::ranges::end(range)), std::move(cmp), std::move(proj));
+}
+
+/// <summary>
+/// Move the k smallest elements of a random access range to its front, in ascending order.
+/// k larger than the range sorts the whole range.
+/// </summary>
+template <
+	std::ranges::random_access_range Range,
+	typename Compare = std::ranges::less,
+	typename Projection = std::identity>
+	requires std::sortable<std::ranges::iterator_t<Range>, Compare, Projection>
+constexpr void heap_partial_sort(Range &&range, std::ranges::range_difference_t<Range> k, Compare cmp = {}, Projection proj = {})
+{
+	auto first = std::ranges::begin(range);
+	auto last = std::ranges::next(first, std::ranges::end(range));
+	heap_sorter<decltype(first), Compare, Projection>(std::move(cmp), std::move(proj)).partial_sort(first, first + std::min(k, last - first), last);
+}
+
+/// <summary>
+/// Print a range as "{a, b, c}".
+/// </summary>
+template <std::ranges::input_range Range>
+void print_content(const Range &c, std::ostream &out = std::cout)
+{
+	out << "{";
+	bool first = true;
+	for (const auto &value : c)
+	{
+		if (!first)
+		{
+			out << ", ";
+		}
+		out << value;
+		first = false;
+	}
+	out << "}" << std::endl;
+}
+
+namespace heap_detail
+{
+	template <std::random_access_iterator It>
+	void print_as_tree(It first, std::iter_difference_t<It> i, std::iter_difference_t<It> len, std::size_t depth, std::ostream &out)
+	{
+		if (i >= len)
+		{
+			return;
+		}
+
+		print_as_tree(first, (i * 2) + 2, len, depth + 2, out);
+		for (std::size_t d = 0; d < depth; ++d)
+		{
+			out << "  ";
+		}
+		out << first[i] << std::endl;
+		print_as_tree(first, (i * 2) + 1, len, depth + 2, out);
+	}
+}
+
+/// <summary>
+/// Print a range interpreted as binary heap, rotated by 90 degrees (root on the left).
+/// </summary>
+template <std::ranges::random_access_range Range>
+void print_as_tree(const Range &c, std::ostream &out = std::cout)
+{
+	heap_detail::print_as_tree(std::ranges::begin(c), 0, std::ranges::distance(c), 0, out);
+}
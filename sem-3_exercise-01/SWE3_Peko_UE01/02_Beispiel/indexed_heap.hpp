@@ -0,0 +1,272 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "heapsort.hpp"
+#include "heap_instrumentation.hpp"
+
+/// <summary>
+/// Addressable priority queue: every pushed entry gets a handle that stays valid
+/// until the entry is popped or erased, and can be used to change its priority
+/// (decrease-key) or to remove it. pop() returns the entry with the smallest
+/// priority with respect to Compare, which is what Dijkstra-style searches and
+/// schedulers need.
+///
+/// Keys and priorities live in flat arrays indexed by handle, the heap itself only
+/// stores handles. The sift operations are heap_sorter's; the handle to heap position
+/// map is kept up to date through an instrumentation policy reacting to every swap.
+/// </summary>
+/// <typeparam name="K">key (payload) type</typeparam>
+/// <typeparam name="P">priority type</typeparam>
+/// <typeparam name="Compare">strict weak ordering on priorities, the smallest is popped first</typeparam>
+template <typename K, typename P, typename Compare = std::ranges::less>
+class indexed_heap
+{
+public:
+	using handle_t = std::size_t;
+	using size_t = std::size_t;
+
+	/// <summary>
+	/// Position of a handle that is not in the heap (popped, erased or never used).
+	/// </summary>
+	static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+	indexed_heap() = default;
+
+	explicit indexed_heap(Compare cmp) : cmp_(std::move(cmp)) {}
+
+	bool empty() const noexcept { return heap_.empty(); }
+
+	size_t size() const noexcept { return heap_.size(); }
+
+	/// <summary>
+	/// Reserve storage for n entries, so pushing them does not reallocate.
+	/// </summary>
+	void reserve(size_t n)
+	{
+		heap_.reserve(n);
+		keys_.reserve(n);
+		priorities_.reserve(n);
+		positions_.reserve(n);
+	}
+
+	/// <summary>
+	/// Insert an entry in O(log n).
+	/// </summary>
+	/// <returns>handle of the new entry; handles of removed entries get reused</returns>
+	handle_t push(K key, P priority)
+	{
+		handle_t h;
+		if (free_.empty())
+		{
+			h = keys_.size();
+			keys_.push_back(std::move(key));
+			priorities_.push_back(std::move(priority));
+			positions_.push_back(npos);
+		}
+		else
+		{
+			h = free_.back();
+			free_.pop_back();
+			keys_[h] = std::move(key);
+			priorities_[h] = std::move(priority);
+		}
+
+		positions_[h] = heap_.size();
+		heap_.push_back(h);
+		sorter().shift_up(heap_.begin(), to_index(heap_.size() - 1));
+		return h;
+	}
+
+	/// <summary>
+	/// Handle of the entry with the smallest priority; throws std::underflow_error if empty.
+	/// </summary>
+	handle_t top() const
+	{
+		if (empty())
+		{
+			throw std::underflow_error("cannot top() an empty indexed_heap");
+		}
+		return heap_.front();
+	}
+
+	/// <summary>
+	/// Remove the entry with the smallest priority in O(log n) and return it;
+	/// throws std::underflow_error if empty.
+	/// </summary>
+	std::pair<K, P> pop()
+	{
+		handle_t const h = top();
+		remove_at(0);
+		std::pair<K, P> entry(std::move(keys_[h]), std::move(priorities_[h]));
+		release(h);
+		return entry;
+	}
+
+	/// <summary>
+	/// Lower the priority of an entry in O(log n).
+	/// Throws std::out_of_range for unknown handles and std::invalid_argument
+	/// if the new priority is greater than the current one (use update() for that).
+	/// </summary>
+	void decrease_key(handle_t h, P priority)
+	{
+		check(h);
+		if (std::invoke(cmp_, priorities_[h], priority))
+		{
+			throw std::invalid_argument("indexed_heap::decrease_key: new priority is greater than the current one");
+		}
+		priorities_[h] = std::move(priority);
+		sorter().shift_up(heap_.begin(), to_index(positions_[h]));
+	}
+
+	/// <summary>
+	/// Set the priority of an entry to any value in O(log n).
+	/// Throws std::out_of_range for unknown handles.
+	/// </summary>
+	void update(handle_t h, P priority)
+	{
+		check(h);
+		priorities_[h] = std::move(priority);
+		restore(positions_[h]);
+	}
+
+	/// <summary>
+	/// Remove an entry in O(log n); its handle becomes invalid.
+	/// Throws std::out_of_range for unknown handles.
+	/// </summary>
+	void erase(handle_t h)
+	{
+		check(h);
+		remove_at(positions_[h]);
+		release(h);
+	}
+
+	/// <summary>
+	/// True if h refers to an entry currently in the heap.
+	/// </summary>
+	bool contains(handle_t h) const noexcept { return h < positions_.size() && positions_[h] != npos; }
+
+	const K &key(handle_t h) const
+	{
+		check(h);
+		return keys_[h];
+	}
+
+	const P &priority(handle_t h) const
+	{
+		check(h);
+		return priorities_[h];
+	}
+
+private:
+	using iterator_t = typename std::vector<handle_t>::iterator;
+
+	/// <summary>
+	/// heap_sorter builds max-heaps, so the ordering is reversed to get the smallest priority on top.
+	/// </summary>
+	struct reversed
+	{
+		[[no_unique_address]] Compare cmp;
+
+		bool operator()(const P &a, const P &b) const { return std::invoke(cmp, b, a); }
+	};
+
+	/// <summary>
+	/// Projection from a handle (the heap element) to its priority.
+	/// </summary>
+	struct priority_of
+	{
+		const std::vector<P> *priorities;
+
+		const P &operator()(handle_t h) const { return (*priorities)[h]; }
+	};
+
+	/// <summary>
+	/// Instrumentation policy updating the handle to position map after every swap and move.
+	/// </summary>
+	struct position_tracking : null_instrumentation
+	{
+		const std::vector<handle_t> *heap;
+		std::vector<size_t> *positions;
+
+		void on_swap(std::ptrdiff_t i, std::ptrdiff_t j)
+		{
+			(*positions)[(*heap)[i]] = static_cast<size_t>(i);
+			(*positions)[(*heap)[j]] = static_cast<size_t>(j);
+		}
+
+		void on_move(std::ptrdiff_t, std::ptrdiff_t to) { (*positions)[(*heap)[to]] = static_cast<size_t>(to); }
+	};
+
+	using sorter_t = heap_sorter<iterator_t, reversed, priority_of, position_tracking>;
+
+	/// <summary>
+	/// The sorter only holds pointers to the arrays, so it is created per operation
+	/// and never dangles when the arrays reallocate or the heap is moved.
+	/// </summary>
+	sorter_t sorter()
+	{
+		position_tracking tracking;
+		tracking.heap = &heap_;
+		tracking.positions = &positions_;
+		return sorter_t(reversed{cmp_}, priority_of{&priorities_}, tracking);
+	}
+
+	static typename sorter_t::index_t to_index(size_t pos) { return static_cast<typename sorter_t::index_t>(pos); }
+
+	/// <summary>
+	/// Sift the entry at pos in whichever direction its priority requires.
+	/// </summary>
+	void restore(size_t pos)
+	{
+		sorter().shift_up(heap_.begin(), to_index(pos));
+		// If it moved up, the entry now at pos is its former parent, which is fine below
+		sorter().shift_down(heap_.begin(), to_index(pos), to_index(heap_.size()));
+	}
+
+	/// <summary>
+	/// Remove the heap slot pos by moving the last entry into it.
+	/// </summary>
+	void remove_at(size_t pos)
+	{
+		handle_t const removed = heap_[pos];
+		size_t const last = heap_.size() - 1;
+		if (pos != last)
+		{
+			heap_[pos] = heap_[last];
+			positions_[heap_[pos]] = pos;
+		}
+		heap_.pop_back();
+		positions_[removed] = npos;
+		if (pos < heap_.size())
+		{
+			restore(pos);
+		}
+	}
+
+	void release(handle_t h)
+	{
+		positions_[h] = npos;
+		free_.push_back(h);
+	}
+
+	void check(handle_t h) const
+	{
+		if (!contains(h))
+		{
+			throw std::out_of_range("indexed_heap: handle does not refer to an entry");
+		}
+	}
+
+	std::vector<handle_t> heap_;
+	std::vector<K> keys_;
+	std::vector<P> priorities_;
+	std::vector<size_t> positions_;
+	std::vector<handle_t> free_;
+	[[no_unique_address]] Compare cmp_{};
+};
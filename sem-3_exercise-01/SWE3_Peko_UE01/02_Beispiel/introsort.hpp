@@ -0,0 +1,264 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+#include "heapsort.hpp"
+#include "heap_instrumentation.hpp"
+
+/// <summary>
+/// Introsort: quicksort with median-of-three (ninther for large ranges) pivots,
+/// insertion sort for small ranges and heap_sorter as fallback once the recursion
+/// gets deeper than 2 * log2(n). This keeps quicksort's locality on typical input
+/// and heapsort's O(n log n) worst case on adversarial input.
+/// Like heap_sorter it sorts in place, never allocates and is constexpr.
+/// </summary>
+/// <typeparam name="RandomIt">random access iterator of the sorted range</typeparam>
+/// <typeparam name="Compare">strict weak ordering on the projected values</typeparam>
+/// <typeparam name="Projection">maps an element to the value it is compared by</typeparam>
+/// <typeparam name="Instrumentation">instrumentation policy, see heap_instrumentation.hpp</typeparam>
+template <
+	std::random_access_iterator RandomIt,
+	typename Compare = std::ranges::less,
+	typename Projection = std::identity,
+	typename Instrumentation = null_instrumentation>
+	requires std::sortable<RandomIt, Compare, Projection>
+class intro_sorter
+{
+public:
+	using iterator_t = RandomIt;
+	using value_t = std::iter_value_t<RandomIt>;
+	using index_t = std::iter_difference_t<RandomIt>;
+
+	/// <summary>
+	/// Ranges up to this size are finished by insertion sort.
+	/// </summary>
+	static constexpr index_t insertion_threshold = 16;
+
+	/// <summary>
+	/// Ranges above this size choose their pivot as ninther (median of three medians).
+	/// </summary>
+	static constexpr index_t ninther_threshold = 128;
+
+	constexpr intro_sorter() = default;
+
+	constexpr explicit intro_sorter(Compare cmp, Projection proj = {}, Instrumentation instrumentation = {})
+		: cmp_(std::move(cmp)), proj_(std::move(proj)), instrumentation_(std::move(instrumentation)) {}
+
+	/// <summary>
+	/// Sort [first, last) in ascending order.
+	/// Resets the instrumentation, so report() afterwards describes exactly this call,
+	/// including the operations of heapsort fallbacks.
+	/// </summary>
+	constexpr void sort(RandomIt first, RandomIt last)
+	{
+		instrumentation_.reset();
+		base_ = first;
+		index_t const len = last - first;
+		if (len < 2)
+		{
+			return;
+		}
+		int const depth_limit = 2 * static_cast<int>(std::bit_width(static_cast<std::make_unsigned_t<index_t>>(len)) - 1);
+		sort_range(first, last, depth_limit);
+	}
+
+	/// <summary>
+	/// Measurements of the last sort call (all zero for null_instrumentation).
+	/// </summary>
+	constexpr sort_report report() const { return instrumentation_.report(); }
+
+	constexpr Instrumentation const &instrumentation() const noexcept { return instrumentation_; }
+
+private:
+	constexpr void sort_range(RandomIt first, RandomIt last, int depth_limit)
+	{
+		while (last - first > insertion_threshold)
+		{
+			if (depth_limit == 0)
+			{
+				// Too many bad pivots, heapsort guarantees n log n for the rest.
+				// It works on a copy of this sorter's policy, which keeps its state and is reset by the fallback's sort,
+				// so merging adds exactly the fallback's counts; trace indices stay relative to the fallback range.
+				heap_sorter<RandomIt, Compare, Projection, Instrumentation> fallback(cmp_, proj_, instrumentation_);
+				fallback.sort(first, last);
+				instrumentation_.merge(fallback.instrumentation());
+				return;
+			}
+			depth_limit--;
+
+			RandomIt cut = partition(first, last);
+
+			// Recurse into the smaller side and loop on the larger one, this bounds the stack to log n
+			if (cut - first < last - cut)
+			{
+				sort_range(first, cut, depth_limit);
+				first = cut + 1;
+			}
+			else
+			{
+				sort_range(cut + 1, last, depth_limit);
+				last = cut;
+			}
+		}
+		insertion_sort(first, last);
+	}
+
+	/// <summary>
+	/// Hoare partition around the selected pivot; returns the pivot's final position.
+	/// Both scans stop on elements equal to the pivot, so many duplicates still split evenly.
+	/// </summary>
+	constexpr RandomIt partition(RandomIt first, RandomIt last)
+	{
+		select_pivot(first, last);
+
+		RandomIt i = first;
+		RandomIt j = last;
+		while (true)
+		{
+			do
+			{
+				++i;
+			} while (i < last && less(i, first));
+			do
+			{
+				--j;
+			} while (less(first, j));
+			if (i >= j)
+			{
+				break;
+			}
+			swap(i, j);
+		}
+		swap(first, j);
+		return j;
+	}
+
+	/// <summary>
+	/// Move the median of three (or the ninther for large ranges) to *first.
+	/// </summary>
+	constexpr void select_pivot(RandomIt first, RandomIt last)
+	{
+		index_t const len = last - first;
+		RandomIt mid = first + len / 2;
+		if (len > ninther_threshold)
+		{
+			index_t const step = len / 8;
+			sort3(first, first + step, first + 2 * step);
+			sort3(mid - step, mid, mid + step);
+			sort3(last - 1 - 2 * step, last - 1 - step, last - 1);
+			sort3(first + step, mid, last - 1 - step);
+		}
+		else
+		{
+			sort3(first, mid, last - 1);
+		}
+		swap(first, mid);
+	}
+
+	/// <summary>
+	/// Order three elements, leaving the median in b.
+	/// </summary>
+	constexpr void sort3(RandomIt a, RandomIt b, RandomIt c)
+	{
+		if (less(b, a))
+		{
+			swap(a, b);
+		}
+		if (less(c, b))
+		{
+			swap(b, c);
+			if (less(b, a))
+			{
+				swap(a, b);
+			}
+		}
+	}
+
+	constexpr void insertion_sort(RandomIt first, RandomIt last)
+	{
+		if (last - first < 2)
+		{
+			return;
+		}
+		for (RandomIt i = first + 1; i != last; ++i)
+		{
+			if (!less(i, i - 1))
+			{
+				continue;
+			}
+			// Shift the larger elements right and drop the current one into the gap
+			value_t current = std::ranges::iter_move(i);
+			RandomIt hole = i;
+			do
+			{
+				move(hole - 1, hole);
+				--hole;
+			} while (hole != first && less_value(current, hole - 1));
+			*hole = std::move(current);
+			instrumentation_.on_move(i - base_, hole - base_);
+		}
+	}
+
+	constexpr bool less(RandomIt a, RandomIt b)
+	{
+		instrumentation_.on_compare(a - base_, b - base_);
+		return std::invoke(cmp_, std::invoke(proj_, *a), std::invoke(proj_, *b));
+	}
+
+	constexpr bool less_value(const value_t &value, RandomIt b)
+	{
+		instrumentation_.on_compare(-1, b - base_);
+		return std::invoke(cmp_, std::invoke(proj_, value), std::invoke(proj_, *b));
+	}
+
+	constexpr void swap(RandomIt a, RandomIt b)
+	{
+		std::ranges::iter_swap(a, b);
+		instrumentation_.on_swap(a - base_, b - base_);
+	}
+
+	constexpr void move(RandomIt from, RandomIt to)
+	{
+		*to = std::ranges::iter_move(from);
+		instrumentation_.on_move(from - base_, to - base_);
+	}
+
+	[[no_unique_address]] Compare cmp_{};
+	[[no_unique_address]] Projection proj_{};
+	[[no_unique_address]] Instrumentation instrumentation_{};
+	RandomIt base_{};
+};
+
+/// <summary>
+/// Sort [first, last) with introsort, without any instrumentation.
+/// </summary>
+template <
+	std::random_access_iterator RandomIt,
+	typename Compare = std::ranges::less,
+	typename Projection = std::identity>
+	requires std::sortable<RandomIt, Compare, Projection>
+constexpr void intro_sort(RandomIt first, RandomIt last, Compare cmp = {}, Projection proj = {})
+{
+	intro_sorter<RandomIt, Compare, Projection>(std::move(cmp), std::move(proj)).sort(first, last);
+}
+
+/// <summary>
+/// Sort a whole random access range with introsort.
+/// </summary>
+template <
+	std::ranges::random_access_range Range,
+	typename Compare = std::ranges::less,
+	typename Projection = std::identity>
+	requires std::sortable<std::ranges::iterator_t<Range>, Compare, Projection>
+constexpr void intro_sort(Range &&range, Compare cmp = {}, Projection proj = {})
+{
+	auto first = std::ranges::begin(range);
+	intro_sort(first, std::ranges::next(first, std::ranges::end(range)), std::move(cmp), std::move(proj));
+}
@@ -1,9 +1,44 @@
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
 #include <vector>
 #include "heapsort.hpp"
+#include "indexed_heap.hpp"
+#include "introsort.hpp"
+#include "pfc-mini.hpp"
+#include "thread_pool.hpp"
+#include "top_k.hpp"
 
-long long count_cmp = 0;
-long long count_swap = 0;
+using iterator_t = std::vector<int>::iterator;
+
+template <std::size_t Arity, sift_strategy Sift>
+using counting_heap_sorter = heap_sorter<iterator_t, std::ranges::less, std::identity, counting_instrumentation, Arity, Sift>;
+
+using counting_intro_sorter = intro_sorter<iterator_t, std::ranges::less, std::identity, counting_instrumentation>;
+
+// The sorter is constexpr, so it can be checked at compile time as well
+constexpr bool sorts_at_compile_time()
+{
+    std::array<int, 6> array = {5, -1, 4, 4, 0, 9};
+    heap_sort(array);
+    return array == std::array<int, 6>{-1, 0, 4, 4, 5, 9};
+}
+static_assert(sorts_at_compile_time());
+
+constexpr bool intro_sorts_at_compile_time()
+{
+    std::array<int, 40> array{};
+    for (int i = 0; i < 40; i++)
+    {
+        array[i] = (i * 17) % 23;
+    }
+    intro_sort(array);
+    return std::ranges::is_sorted(array);
+}
+static_assert(intro_sorts_at_compile_time());
 
 std::vector<int> generate_random_array(int size)
 {
@@ -15,30 +50,262 @@ std::vector<int> generate_random_array(int size)
     return array;
 }
 
-std::pair<long long, long long> run_for_size(int size, int iterations)
+// Partial sorting and top-k selection against the standard library on random arrays and all kinds of k
+bool selects_like_std()
+{
+    for (int size : {0, 1, 7, 100, 1000})
+    {
+        for (int k : {0, 1, 3, size / 2, size - 1, size, size + 5})
+        {
+            if (k < 0)
+            {
+                continue;
+            }
+            std::vector<int> array = generate_random_array(size);
+            std::size_t const kept = std::min<std::size_t>(k, array.size());
+
+            std::vector<int> expected = array;
+            std::partial_sort(expected.begin(), expected.begin() + kept, expected.end());
+            expected.resize(kept);
+
+            std::vector<int> partial = array;
+            heap_partial_sort(partial, k);
+            std::vector<int> rest(partial.begin() + kept, partial.end());
+            std::ranges::sort(rest);
+            std::vector<int> all = array;
+            std::ranges::sort(all);
+            // The first k are the k smallest in order, the others are a permutation of the remaining elements
+            if (!std::equal(expected.begin(), expected.end(), partial.begin()) ||
+                !std::ranges::equal(rest, std::ranges::subrange(all.begin() + kept, all.end())))
+            {
+                return false;
+            }
+
+            top_k<int> smallest(k);
+            smallest.push(array.begin(), array.end());
+            if (smallest.size() != kept || smallest.sorted() != expected)
+            {
+                return false;
+            }
+
+            // The threshold of a full accumulator is the k-th smallest element
+            if (kept > 0 && kept < array.size())
+            {
+                std::vector<int> nth = array;
+                std::nth_element(nth.begin(), nth.begin() + (kept - 1), nth.end());
+                if (!smallest.full() || smallest.threshold() != nth[kept - 1])
+                {
+                    return false;
+                }
+            }
+
+            // Largest k through the ordering, consuming the accumulator
+            top_k<int, std::ranges::greater> largest(k);
+            largest.push(array.begin(), array.end());
+            std::vector<int> descending = all;
+            std::ranges::reverse(descending);
+            descending.resize(kept);
+            if (std::move(largest).sorted() != descending)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Random pushes, pops, priority changes and erasures on an indexed_heap, mirrored on a std::set of
+// (priority, id) pairs; handles are only reachable through the position map, so any stale position shows
+bool indexed_heap_agrees_with_set()
 {
-    // Reset counters
-    count_cmp = 0;
-    count_swap = 0;
+    indexed_heap<int, int> heap;
+    std::set<std::pair<int, int>> expected;
+    std::map<int, indexed_heap<int, int>::handle_t> handles;
+    int next_id = 0;
+
+    auto any_id = [&]
+    {
+        auto it = handles.begin();
+        std::advance(it, rand() % handles.size());
+        return it->first;
+    };
+
+    for (int step = 0; step < 20000; step++)
+    {
+        int const action = handles.empty() ? 0 : rand() % 5;
+        int const priority = rand() % 1000;
+        if (action == 0)
+        {
+            int const id = next_id++;
+            handles[id] = heap.push(id, priority);
+            expected.emplace(priority, id);
+        }
+        else if (action == 1)
+        {
+            auto [id, popped] = heap.pop();
+            // Ties may come out in any order, but the priority has to be the smallest
+            if (popped != expected.begin()->first || expected.erase({popped, id}) != 1)
+            {
+                return false;
+            }
+            handles.erase(id);
+        }
+        else
+        {
+            int const id = any_id();
+            auto const h = handles[id];
+            int const current = heap.priority(h);
+            if (heap.key(h) != id || !expected.contains({current, id}))
+            {
+                return false;
+            }
+            expected.erase({current, id});
+            if (action == 2)
+            {
+                heap.decrease_key(h, current - priority % 100);
+                expected.emplace(current - priority % 100, id);
+            }
+            else if (action == 3)
+            {
+                heap.update(h, priority);
+                expected.emplace(priority, id);
+            }
+            else
+            {
+                heap.erase(h);
+                handles.erase(id);
+                if (heap.contains(h))
+                {
+                    return false;
+                }
+            }
+        }
+        if (heap.size() != expected.size() || (!heap.empty() && heap.priority(heap.top()) != expected.begin()->first))
+        {
+            return false;
+        }
+    }
+
+    // decrease_key refuses to raise a priority and leaves the entry untouched
+    if (!handles.empty())
+    {
+        auto const h = handles.begin()->second;
+        int const current = heap.priority(h);
+        try
+        {
+            heap.decrease_key(h, current + 1);
+            return false;
+        }
+        catch (const std::invalid_argument &)
+        {
+        }
+        if (heap.priority(h) != current)
+        {
+            return false;
+        }
+    }
 
-    // Take iterations testsamples
+    // Draining yields the remaining entries in ascending priority
+    while (!heap.empty())
+    {
+        auto [id, popped] = heap.pop();
+        if (popped != expected.begin()->first || expected.erase({popped, id}) != 1)
+        {
+            return false;
+        }
+    }
+    return expected.empty();
+}
+
+// Summed up reports of one sorter variant over all iterations of a size
+struct variant_totals
+{
+    const char *name;
+    // The cache model follows heap descents, introsort only descends in its rare heapsort fallbacks
+    bool models_cache = true;
+    long long comparisons = 0;
+    long long swaps = 0;
+    long long moves = 0;
+    long long cache_misses = 0;
+    double seconds = 0;
+};
+
+template <typename Sorter>
+void sort_and_count(std::vector<int> array, variant_totals &totals)
+{
+    Sorter sorter;
+    auto time = pfc::timed_run(1, [&] { sorter.sort(array.begin(), array.end()); });
+    totals.seconds += pfc::in_s(time);
+
+    sort_report report = sorter.report();
+    totals.comparisons += report.comparisons;
+    totals.swaps += report.swaps;
+    totals.moves += report.moves;
+    totals.cache_misses += report.estimated_cache_misses;
+}
+
+// Average time of building a heap over a copy of array, without the time of the copy
+template <typename Build>
+double build_heap_seconds(const std::vector<int> &array, int iterations, Build build)
+{
+    std::vector<int> work;
+    auto copy_time = pfc::timed_run(iterations, [&] { work = array; });
+    auto build_time = pfc::timed_run(iterations, [&] { work = array; build(work); });
+    return pfc::in_s(build_time) - pfc::in_s(copy_time);
+}
+
+std::pair<long long, long long> run_for_size(int size, int iterations, thread_pool &pool)
+{
+    variant_totals variants[] = {
+        {"binary, top-down"},
+        {"binary, bottom-up"},
+        {"4-ary, bottom-up"},
+        {"cache line (16-ary), bottom-up"},
+        {"introsort (heapsort fallback)", false},
+    };
+
+    // Take iterations testsamples, every variant sorts the same arrays
     for (int i = 0; i < iterations; i++)
     {
         std::vector<int> array = generate_random_array(size);
-        heap_sorter::sort(array);
+        sort_and_count<counting_heap_sorter<2, sift_strategy::top_down>>(array, variants[0]);
+        sort_and_count<counting_heap_sorter<2, sift_strategy::bottom_up>>(array, variants[1]);
+        sort_and_count<counting_heap_sorter<4, sift_strategy::bottom_up>>(array, variants[2]);
+        sort_and_count<counting_heap_sorter<cache_line_arity<int>, sift_strategy::bottom_up>>(array, variants[3]);
+        sort_and_count<counting_intro_sorter>(array, variants[4]);
     }
 
-    // Calculate average
-    auto average_comparisons = count_cmp / iterations;
-    auto average_swaps = count_swap / iterations;
-
-    // Print results
+    // Print averages
     std::cout << "Size: " << size << std::endl;
-    std::cout << "Average comparisons: " << std::fixed << average_comparisons << std::endl;
-    std::cout << "Average swaps: " << std::fixed << average_swaps << std::endl;
+    for (const auto &variant : variants)
+    {
+        std::cout << "  " << variant.name << ": "
+                  << "comparisons " << variant.comparisons / iterations
+                  << ", swaps " << variant.swaps / iterations
+                  << ", moves " << variant.moves / iterations;
+        if (variant.models_cache)
+        {
+            std::cout << ", estimated cache misses " << variant.cache_misses / iterations;
+        }
+        std::cout << ", time " << variant.seconds / iterations * 1e3 << " ms" << std::endl;
+    }
+
+    // Heap construction alone, serial against parallel on the pool
+    std::vector<int> array = generate_random_array(size);
+    heap_sorter<iterator_t> sorter;
+    double serial = build_heap_seconds(array, iterations, [&](std::vector<int> &work)
+    {
+        sorter.make_heap(work.begin(), work.end());
+    });
+    double parallel = build_heap_seconds(array, iterations, [&](std::vector<int> &work)
+    {
+        sorter.make_heap(work.begin(), work.end(), pool);
+    });
+    std::cout << "  build_heap: serial " << serial * 1e3 << " ms, parallel (" << pool.size() << " threads) "
+              << parallel * 1e3 << " ms, speedup " << (parallel > 0 ? serial / parallel : 0) << std::endl;
     std::cout << std::endl;
 
-    return std::make_pair(average_comparisons, average_swaps);
+    return std::make_pair(variants[0].comparisons / iterations, variants[0].swaps / iterations);
 }
 
 void print_vector(const std::vector<long long>& vec)
@@ -54,14 +321,26 @@ void print_vector(const std::vector<long long>& vec)
 
 int main()
 {
-    int sizes[] = {100, 200, 500, 1000, 2000, 5000, 10000, 15000, 20000, 30000, 40000, 60000, 80000, 100000};
+    int sizes[] = {100, 200, 500, 1000, 2000, 5000, 10000, 15000, 20000, 30000, 40000, 60000, 80000, 100000, 1000000};
     std::vector<long long> compares;
     std::vector<long long> swaps;
     int iterations = 25;
+    thread_pool pool;
+
+    if (!selects_like_std())
+    {
+        std::cout << "heap_partial_sort/top_k disagree with std::partial_sort" << std::endl;
+        return 1;
+    }
+    if (!indexed_heap_agrees_with_set())
+    {
+        std::cout << "indexed_heap disagrees with std::set" << std::endl;
+        return 1;
+    }
 
     for (int size : sizes)
     {
-        auto result = run_for_size(size, iterations);
+        auto result = run_for_size(size, iterations, pool);
         compares.push_back(result.first);
         swaps.push_back(result.second);
     }
@@ -0,0 +1,46 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+thread_pool::thread_pool(std::size_t threads)
+{
+	threads = std::max<std::size_t>(1, threads);
+	workers_.reserve(threads);
+	for (std::size_t i = 0; i < threads; ++i)
+	{
+		workers_.emplace_back([this] { work(); });
+	}
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard lock(mutex_);
+		stopping_ = true;
+	}
+	wakeup_.notify_all();
+	for (auto &worker : workers_)
+	{
+		worker.join();
+	}
+}
+
+void thread_pool::work()
+{
+	while (true)
+	{
+		std::packaged_task<void()> task;
+		{
+			std::unique_lock lock(mutex_);
+			wakeup_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+			if (tasks_.empty())
+			{
+				// Only reached when stopping and all work is done
+				return;
+			}
+			task = std::move(tasks_.front());
+			tasks_.pop();
+		}
+		task();
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Fixed size pool of worker threads executing submitted tasks in FIFO order.
+/// The threads are started once and reused, so short parallel phases
+/// (like building the lower levels of a heap) do not pay for thread creation.
+/// </summary>
+class thread_pool
+{
+public:
+	/// <summary>
+	/// Start the given number of worker threads (at least one).
+	/// </summary>
+	/// <param name="threads">number of workers, defaults to the number of hardware threads</param>
+	explicit thread_pool(std::size_t threads = std::thread::hardware_concurrency());
+
+	/// <summary>
+	/// Finish all queued tasks, then join the workers.
+	/// </summary>
+	~thread_pool();
+
+	thread_pool(const thread_pool &) = delete;
+	thread_pool &operator=(const thread_pool &) = delete;
+
+	/// <summary>
+	/// Number of worker threads.
+	/// </summary>
+	std::size_t size() const noexcept { return workers_.size(); }
+
+	/// <summary>
+	/// Queue a task for execution.
+	/// </summary>
+	/// <returns>future that becomes ready when the task has run; rethrows the task's exception</returns>
+	template <typename Task>
+	std::future<void> submit(Task task)
+	{
+		std::packaged_task<void()> packaged(std::move(task));
+		auto result = packaged.get_future();
+		{
+			std::lock_guard lock(mutex_);
+			tasks_.push(std::move(packaged));
+		}
+		wakeup_.notify_one();
+		return result;
+	}
+
+private:
+	void work();
+
+	std::vector<std::thread> workers_;
+	std::queue<std::packaged_task<void()>> tasks_;
+	std::mutex mutex_;
+	std::condition_variable wakeup_;
+	bool stopping_ = false;
+};
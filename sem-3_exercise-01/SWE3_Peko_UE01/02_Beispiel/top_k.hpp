@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+#include "heapsort.hpp"
+
+/// <summary>
+/// Streaming accumulator keeping the k smallest elements seen so far.
+/// The kept elements form a max-heap of bounded size k (using heap_sorter's sift
+/// operations), so consuming n elements takes O(n log k) time and O(k) memory:
+/// an element is only sifted if it is smaller than the largest kept one.
+/// </summary>
+/// <typeparam name="T">element type</typeparam>
+/// <typeparam name="Compare">strict weak ordering on the projected values</typeparam>
+/// <typeparam name="Projection">maps an element to the value it is compared by</typeparam>
+template <typename T, typename Compare = std::ranges::less, typename Projection = std::identity>
+class top_k
+{
+public:
+	using container_t = std::vector<T>;
+	using size_t = std::size_t;
+	using sorter_t = heap_sorter<typename container_t::iterator, Compare, Projection>;
+
+	/// <summary>
+	/// Create an empty accumulator; the heap storage for k elements is allocated up front.
+	/// </summary>
+	/// <param name="k">number of elements to keep</param>
+	explicit top_k(size_t k, Compare cmp = {}, Projection proj = {})
+		: k_(k), cmp_(cmp), proj_(proj), sorter_(std::move(cmp), std::move(proj))
+	{
+		heap_.reserve(k);
+	}
+
+	/// <summary>
+	/// Consume one element.
+	/// </summary>
+	void push(T value)
+	{
+		if (heap_.size() < k_)
+		{
+			heap_.push_back(std::move(value));
+			sorter_.shift_up(heap_.begin(), static_cast<typename sorter_t::index_t>(heap_.size() - 1));
+		}
+		else if (k_ > 0 && std::invoke(cmp_, std::invoke(proj_, value), std::invoke(proj_, heap_.front())))
+		{
+			// Smaller than the largest kept element: it replaces the maximum
+			heap_.front() = std::move(value);
+			sorter_.shift_down(heap_.begin(), 0, static_cast<typename sorter_t::index_t>(heap_.size()));
+		}
+	}
+
+	/// <summary>
+	/// Consume all elements of [first, last).
+	/// </summary>
+	template <std::input_iterator It, std::sentinel_for<It> Sentinel>
+	void push(It first, Sentinel last)
+	{
+		for (; first != last; ++first)
+		{
+			push(*first);
+		}
+	}
+
+	/// <summary>
+	/// Number of elements kept, at most k.
+	/// </summary>
+	size_t size() const noexcept { return heap_.size(); }
+
+	size_t k() const noexcept { return k_; }
+
+	/// <summary>
+	/// True once k elements are kept, i.e. new elements have to beat threshold().
+	/// </summary>
+	bool full() const noexcept { return heap_.size() == k_; }
+
+	/// <summary>
+	/// The largest kept element. Requires size() > 0.
+	/// </summary>
+	const T &threshold() const { return heap_.front(); }
+
+	/// <summary>
+	/// The kept elements in ascending order.
+	/// </summary>
+	container_t sorted() const &
+	{
+		container_t result = heap_;
+		sorter_t(cmp_, proj_).sort(result.begin(), result.end());
+		return result;
+	}
+
+	/// <summary>
+	/// The kept elements in ascending order, reusing the heap's storage.
+	/// </summary>
+	container_t sorted() &&
+	{
+		sorter_.sort(heap_.begin(), heap_.end());
+		return std::move(heap_);
+	}
+
+private:
+	size_t k_;
+	container_t heap_;
+	[[no_unique_address]] Compare cmp_;
+	[[no_unique_address]] Projection proj_;
+	sorter_t sorter_;
+};
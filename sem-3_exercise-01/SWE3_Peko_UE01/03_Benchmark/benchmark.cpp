@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "distributions.hpp"
+#include "hardware_counters.hpp"
+#include "heapsort.hpp"
+#include "introsort.hpp"
+#include "pfc-mini.hpp"
+#include "thread_pool.hpp"
+
+using element_t = std::uint64_t;
+using keys_t = std::vector<element_t>;
+using iterator_t = keys_t::iterator;
+
+template <std::size_t Arity, sift_strategy Sift>
+using plain_heap_sorter = heap_sorter<iterator_t, std::ranges::less, std::identity, null_instrumentation, Arity, Sift>;
+
+// A benchmarked algorithm, sorting the keys in place
+struct algorithm
+{
+    const char *name;
+    std::function<void(keys_t &)> sort;
+};
+
+// Command line settings, see print_usage
+struct options
+{
+    std::size_t min_size = 1000;
+    std::size_t max_size = 10000000;
+    int repetitions = 0; // 0 picks a count per size
+    std::uint64_t seed = 42;
+    std::vector<distribution> distributions{std::begin(all_distributions), std::end(all_distributions)};
+    std::vector<std::string> algorithms; // empty runs all
+    std::string csv_path;
+    std::string json_path;
+};
+
+// Timings and counters of one algorithm on one distribution and size
+struct result
+{
+    std::string algorithm;
+    std::string distribution;
+    std::size_t size = 0;
+    int repetitions = 0;
+    double min_s = 0;
+    double median_s = 0;
+    double mean_s = 0;
+    double elements_per_s = 0;
+    hardware_sample counters; // averaged over the repetitions
+};
+
+void print_usage()
+{
+    std::cout << "usage: 03_Benchmark [options]\n"
+              << "  --min-size N         smallest input size (default 1000)\n"
+              << "  --max-size N         largest input size, sizes grow by factor 10 (default 10^7, up to 10^8)\n"
+              << "  --repetitions N      sorts per measurement (default: more for small sizes)\n"
+              << "  --seed N             seed of the input generator (default 42)\n"
+              << "  --distributions a,b  any of uniform,sorted,reverse,organ_pipe,few_unique,zipf\n"
+              << "  --algorithms a,b     subset of the algorithm names printed by --list\n"
+              << "  --list               print the algorithm names and exit\n"
+              << "  --csv FILE           write the results as CSV\n"
+              << "  --json FILE          write the results as JSON\n";
+}
+
+std::vector<std::string> split(const std::string &text, char separator)
+{
+    std::vector<std::string> parts;
+    std::size_t start = 0;
+    while (start <= text.size())
+    {
+        std::size_t end = text.find(separator, start);
+        if (end == std::string::npos)
+        {
+            end = text.size();
+        }
+        if (end > start)
+        {
+            parts.push_back(text.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return parts;
+}
+
+std::vector<algorithm> make_algorithms(thread_pool &pool)
+{
+    return {
+        {"heap_binary_top_down", [](keys_t &keys) { plain_heap_sorter<2, sift_strategy::top_down>().sort(keys.begin(), keys.end()); }},
+        {"heap_binary_bottom_up", [](keys_t &keys) { plain_heap_sorter<2, sift_strategy::bottom_up>().sort(keys.begin(), keys.end()); }},
+        {"heap_4ary_bottom_up", [](keys_t &keys) { plain_heap_sorter<4, sift_strategy::bottom_up>().sort(keys.begin(), keys.end()); }},
+        {"heap_cache_line_bottom_up", [](keys_t &keys) { plain_heap_sorter<cache_line_arity<element_t>, sift_strategy::bottom_up>().sort(keys.begin(), keys.end()); }},
+        {"heap_binary_parallel_build", [&pool](keys_t &keys) { plain_heap_sorter<2, sift_strategy::bottom_up>().sort(keys.begin(), keys.end(), pool); }},
+        {"introsort", [](keys_t &keys) { intro_sort(keys); }},
+        {"std_sort", [](keys_t &keys) { std::sort(keys.begin(), keys.end()); }},
+    };
+}
+
+options parse_options(int argc, char *argv[])
+{
+    options opts;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string const arg = argv[i];
+        auto value = [&]() -> std::string
+        {
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--min-size")
+        {
+            opts.min_size = std::stoull(value());
+        }
+        else if (arg == "--max-size")
+        {
+            opts.max_size = std::stoull(value());
+        }
+        else if (arg == "--repetitions")
+        {
+            opts.repetitions = std::stoi(value());
+        }
+        else if (arg == "--seed")
+        {
+            opts.seed = std::stoull(value());
+        }
+        else if (arg == "--distributions")
+        {
+            opts.distributions.clear();
+            for (const auto &name : split(value(), ','))
+            {
+                opts.distributions.push_back(parse_distribution(name));
+            }
+        }
+        else if (arg == "--algorithms")
+        {
+            opts.algorithms = split(value(), ',');
+        }
+        else if (arg == "--csv")
+        {
+            opts.csv_path = value();
+        }
+        else if (arg == "--json")
+        {
+            opts.json_path = value();
+        }
+        else
+        {
+            throw std::invalid_argument("unknown option " + arg);
+        }
+    }
+
+    if (opts.min_size == 0 || opts.min_size > opts.max_size)
+    {
+        throw std::invalid_argument("--min-size must be positive and not above --max-size");
+    }
+    return opts;
+}
+
+// Small inputs are repeated more often, so every measurement takes roughly the same time
+int repetitions_for(std::size_t size, const options &opts)
+{
+    if (opts.repetitions > 0)
+    {
+        return opts.repetitions;
+    }
+    return static_cast<int>(std::clamp<std::size_t>(10000000 / size, 3, 25));
+}
+
+void add_counter(std::optional<std::uint64_t> &sum, const std::optional<std::uint64_t> &sample)
+{
+    if (sample)
+    {
+        sum = sum.value_or(0) + *sample;
+    }
+}
+
+void average_counter(std::optional<std::uint64_t> &sum, int repetitions)
+{
+    if (sum)
+    {
+        *sum /= static_cast<std::uint64_t>(repetitions);
+    }
+}
+
+// Sorts a fresh copy of input per repetition; only the sort itself is timed and counted
+result measure(const algorithm &algo, distribution dist, const keys_t &input, int repetitions, hardware_counters &counters)
+{
+    result res;
+    res.algorithm = algo.name;
+    res.distribution = to_string(dist);
+    res.size = input.size();
+    res.repetitions = repetitions;
+    std::vector<double> seconds;
+    keys_t work;
+
+    for (int r = 0; r < repetitions; r++)
+    {
+        work = input;
+        counters.start();
+        auto time = pfc::timed_run(1, [&] { algo.sort(work); });
+        hardware_sample sample = counters.stop();
+        seconds.push_back(pfc::in_s(time));
+
+        add_counter(res.counters.cycles, sample.cycles);
+        add_counter(res.counters.instructions, sample.instructions);
+        add_counter(res.counters.cache_misses, sample.cache_misses);
+        add_counter(res.counters.branch_misses, sample.branch_misses);
+
+        if (!std::is_sorted(work.begin(), work.end()))
+        {
+            throw std::logic_error(std::string(algo.name) + " did not sort " + res.distribution + " input of size " + std::to_string(input.size()));
+        }
+    }
+
+    average_counter(res.counters.cycles, repetitions);
+    average_counter(res.counters.instructions, repetitions);
+    average_counter(res.counters.cache_misses, repetitions);
+    average_counter(res.counters.branch_misses, repetitions);
+
+    std::sort(seconds.begin(), seconds.end());
+    res.min_s = seconds.front();
+    res.median_s = seconds[seconds.size() / 2];
+    for (double s : seconds)
+    {
+        res.mean_s += s / repetitions;
+    }
+    res.elements_per_s = res.median_s > 0 ? input.size() / res.median_s : 0;
+    return res;
+}
+
+std::string counter_text(const std::optional<std::uint64_t> &counter, const char *missing)
+{
+    return counter ? std::to_string(*counter) : missing;
+}
+
+void write_csv(const std::vector<result> &results, const std::string &path)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        throw std::runtime_error("cannot open " + path);
+    }
+    out << "algorithm,distribution,size,repetitions,min_s,median_s,mean_s,elements_per_s,cycles,instructions,cache_misses,branch_misses\n";
+    for (const auto &res : results)
+    {
+        out << res.algorithm << ',' << res.distribution << ',' << res.size << ',' << res.repetitions << ','
+            << res.min_s << ',' << res.median_s << ',' << res.mean_s << ',' << res.elements_per_s << ','
+            << counter_text(res.counters.cycles, "") << ',' << counter_text(res.counters.instructions, "") << ','
+            << counter_text(res.counters.cache_misses, "") << ',' << counter_text(res.counters.branch_misses, "") << '\n';
+    }
+}
+
+void write_json(const std::vector<result> &results, const std::string &path)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        throw std::runtime_error("cannot open " + path);
+    }
+    out << "{\n  \"entries\": [";
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        const auto &res = results[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"algorithm\": \"" << res.algorithm << "\", \"distribution\": \"" << res.distribution
+            << "\", \"size\": " << res.size << ", \"repetitions\": " << res.repetitions
+            << ", \"min_s\": " << res.min_s << ", \"median_s\": " << res.median_s << ", \"mean_s\": " << res.mean_s
+            << ", \"elements_per_s\": " << res.elements_per_s
+            << ", \"cycles\": " << counter_text(res.counters.cycles, "null")
+            << ", \"instructions\": " << counter_text(res.counters.instructions, "null")
+            << ", \"cache_misses\": " << counter_text(res.counters.cache_misses, "null")
+            << ", \"branch_misses\": " << counter_text(res.counters.branch_misses, "null") << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::string(argv[i]) == "--help")
+            {
+                print_usage();
+                return 0;
+            }
+        }
+
+        thread_pool pool;
+        std::vector<algorithm> algorithms = make_algorithms(pool);
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::string(argv[i]) == "--list")
+            {
+                for (const auto &algo : algorithms)
+                {
+                    std::cout << algo.name << std::endl;
+                }
+                return 0;
+            }
+        }
+
+        options opts = parse_options(argc, argv);
+        if (!opts.algorithms.empty())
+        {
+            std::erase_if(algorithms, [&](const algorithm &algo)
+                          { return std::find(opts.algorithms.begin(), opts.algorithms.end(), algo.name) == opts.algorithms.end(); });
+            if (algorithms.empty())
+            {
+                throw std::invalid_argument("--algorithms selects no known algorithm, see --list");
+            }
+        }
+
+        hardware_counters counters;
+        if (!counters.available())
+        {
+            std::cout << "Hardware counters: n/a on this platform" << std::endl;
+        }
+
+        std::vector<result> results;
+        for (std::size_t size = opts.min_size; size <= opts.max_size; size *= 10)
+        {
+            int const repetitions = repetitions_for(size, opts);
+            for (distribution dist : opts.distributions)
+            {
+                // Generated once outside of any timing, every algorithm sorts the same keys
+                keys_t const input = generate_keys(dist, size, opts.seed);
+                std::cout << "Size: " << size << ", " << to_string(dist) << std::endl;
+                for (const auto &algo : algorithms)
+                {
+                    result res = measure(algo, dist, input, repetitions, counters);
+                    std::cout << "  " << res.algorithm << ": median " << res.median_s * 1e3 << " ms, min "
+                              << res.min_s * 1e3 << " ms, " << res.elements_per_s / 1e6 << " M elements/s";
+                    if (res.counters.cycles && res.counters.instructions && *res.counters.cycles > 0)
+                    {
+                        std::cout << ", IPC " << static_cast<double>(*res.counters.instructions) / *res.counters.cycles;
+                    }
+                    std::cout << std::endl;
+                    results.push_back(std::move(res));
+                }
+            }
+            if (size > opts.max_size / 10)
+            {
+                break;
+            }
+        }
+
+        if (!opts.csv_path.empty())
+        {
+            write_csv(results, opts.csv_path);
+        }
+        if (!opts.json_path.empty())
+        {
+            write_json(results, opts.json_path);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        print_usage();
+        return 1;
+    }
+    return 0;
+}
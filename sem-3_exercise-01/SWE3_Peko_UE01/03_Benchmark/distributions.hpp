@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Input patterns the sorters are benchmarked on.
+/// </summary>
+enum class distribution
+{
+	uniform,    // uniformly random 64 bit keys
+	sorted,     // already ascending
+	reverse,    // strictly descending
+	organ_pipe, // ascending first half, descending second half
+	few_unique, // only 16 distinct keys, i.e. many duplicates
+	zipf        // Zipf distributed ranks (s = 1), few keys are very frequent
+};
+
+inline constexpr distribution all_distributions[] = {
+	distribution::uniform,
+	distribution::sorted,
+	distribution::reverse,
+	distribution::organ_pipe,
+	distribution::few_unique,
+	distribution::zipf,
+};
+
+inline const char *to_string(distribution d)
+{
+	switch (d)
+	{
+	case distribution::uniform: return "uniform";
+	case distribution::sorted: return "sorted";
+	case distribution::reverse: return "reverse";
+	case distribution::organ_pipe: return "organ_pipe";
+	case distribution::few_unique: return "few_unique";
+	case distribution::zipf: return "zipf";
+	}
+	return "unknown";
+}
+
+inline distribution parse_distribution(const std::string &name)
+{
+	for (distribution d : all_distributions)
+	{
+		if (name == to_string(d))
+		{
+			return d;
+		}
+	}
+	throw std::invalid_argument("unknown distribution: " + name);
+}
+
+/// <summary>
+/// Scramble a rank into a key, so frequent Zipf ranks are spread over the key space.
+/// </summary>
+inline std::uint64_t mix_key(std::uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/// <summary>
+/// Generate n keys following the distribution; the same seed gives the same keys.
+/// </summary>
+inline std::vector<std::uint64_t> generate_keys(distribution d, std::size_t n, std::uint64_t seed)
+{
+	std::vector<std::uint64_t> keys(n);
+	std::mt19937_64 engine(seed);
+	switch (d)
+	{
+	case distribution::uniform:
+		for (auto &key : keys)
+		{
+			key = engine();
+		}
+		break;
+	case distribution::sorted:
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			keys[i] = i;
+		}
+		break;
+	case distribution::reverse:
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			keys[i] = n - i;
+		}
+		break;
+	case distribution::organ_pipe:
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			keys[i] = i < n / 2 ? i : n - i;
+		}
+		break;
+	case distribution::few_unique:
+		for (auto &key : keys)
+		{
+			key = engine() % 16;
+		}
+		break;
+	case distribution::zipf:
+	{
+		// Inverse transform sampling over a cumulative table of at most 2^20 ranks
+		std::size_t const ranks = std::clamp<std::size_t>(n, 1, std::size_t{1} << 20);
+		std::vector<double> cumulative(ranks);
+		double sum = 0;
+		for (std::size_t r = 0; r < ranks; ++r)
+		{
+			sum += 1.0 / static_cast<double>(r + 1);
+			cumulative[r] = sum;
+		}
+		std::uniform_real_distribution<double> uniform(0.0, sum);
+		for (auto &key : keys)
+		{
+			auto rank = std::lower_bound(cumulative.begin(), cumulative.end(), uniform(engine)) - cumulative.begin();
+			key = mix_key(static_cast<std::uint64_t>(rank));
+		}
+		break;
+	}
+	}
+	return keys;
+}
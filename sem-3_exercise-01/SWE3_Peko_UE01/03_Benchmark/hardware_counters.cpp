@@ -0,0 +1,124 @@
+#include "hardware_counters.hpp"
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+	// Same order as the members of hardware_sample
+	constexpr std::uint64_t events[] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+
+	int open_counter(std::uint64_t event)
+	{
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = event;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+
+	std::optional<std::uint64_t> read_counter(int fd)
+	{
+		std::uint64_t value = 0;
+		if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value))
+		{
+			return std::nullopt;
+		}
+		return value;
+	}
+}
+
+hardware_counters::hardware_counters()
+{
+	for (int i = 0; i < event_count; ++i)
+	{
+		fds_[i] = open_counter(events[i]);
+	}
+}
+
+hardware_counters::~hardware_counters()
+{
+	for (int fd : fds_)
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+}
+
+bool hardware_counters::available() const noexcept
+{
+	for (int fd : fds_)
+	{
+		if (fd >= 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void hardware_counters::start()
+{
+	for (int fd : fds_)
+	{
+		if (fd >= 0)
+		{
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+hardware_sample hardware_counters::stop()
+{
+	for (int fd : fds_)
+	{
+		if (fd >= 0)
+		{
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+	return {read_counter(fds_[0]), read_counter(fds_[1]), read_counter(fds_[2]), read_counter(fds_[3])};
+}
+
+#else
+
+// No portable user mode access to performance counters (Windows would need ETW/PMC drivers)
+hardware_counters::hardware_counters()
+{
+	for (int &fd : fds_)
+	{
+		fd = -1;
+	}
+}
+
+hardware_counters::~hardware_counters() = default;
+
+bool hardware_counters::available() const noexcept
+{
+	return false;
+}
+
+void hardware_counters::start() {}
+
+hardware_sample hardware_counters::stop()
+{
+	return {};
+}
+
+#endif
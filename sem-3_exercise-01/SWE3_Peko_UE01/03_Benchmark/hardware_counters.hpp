@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+/// <summary>
+/// CPU event counts of one measured region. Counters that are not available
+/// on this platform (or not permitted by the kernel) stay empty.
+/// </summary>
+struct hardware_sample
+{
+	std::optional<std::uint64_t> cycles;
+	std::optional<std::uint64_t> instructions;
+	std::optional<std::uint64_t> cache_misses;
+	std::optional<std::uint64_t> branch_misses;
+};
+
+/// <summary>
+/// Reads CPU performance counters around a measured region of the calling thread.
+/// Uses perf_event_open on Linux; elsewhere every sample is empty.
+/// </summary>
+class hardware_counters
+{
+public:
+	hardware_counters();
+	~hardware_counters();
+
+	hardware_counters(const hardware_counters &) = delete;
+	hardware_counters &operator=(const hardware_counters &) = delete;
+
+	/// <summary>
+	/// True if at least one counter could be opened.
+	/// </summary>
+	bool available() const noexcept;
+
+	/// <summary>
+	/// Reset and enable all counters.
+	/// </summary>
+	void start();
+
+	/// <summary>
+	/// Disable all counters and read the events since start().
+	/// </summary>
+	hardware_sample stop();
+
+private:
+	static constexpr int event_count = 4;
+	int fds_[event_count];
+};
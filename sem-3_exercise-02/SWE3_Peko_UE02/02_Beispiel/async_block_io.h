@@ -0,0 +1,252 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Byte blocks travelling between the merging thread and a background I/O thread.
+/// Buffers are recycled, so a pipeline of depth d allocates at most d + 1 blocks.
+/// </summary>
+using io_block = std::vector<char>;
+
+/// <summary>
+/// Prefetching block source: a background thread calls read_block ahead of the consumer
+/// and keeps up to queue_depth filled blocks waiting, so reading overlaps with merging.
+/// With queue_depth 0 next() reads synchronously on the calling thread.
+/// Exceptions thrown by read_block are rethrown by next(), also on every later call.
+/// </summary>
+class read_ahead {
+public:
+    /// <summary>
+    /// Fills the given block with the next block of data; returns false at the end of the data.
+    /// </summary>
+    using read_fn = std::function<bool(io_block&)>;
+
+    /// <summary>
+    /// Start prefetching; read_block must stay callable until this object is destroyed.
+    /// </summary>
+    /// <param name="read_block">Reads one block, called on the background thread.</param>
+    /// <param name="queue_depth">Number of blocks read ahead; 0 disables the background thread.</param>
+    read_ahead(read_fn read_block, std::size_t queue_depth)
+        : _read_block(std::move(read_block)), _queue_depth(queue_depth) {
+        if (_queue_depth > 0) {
+            _worker = std::thread([this] { produce(); });
+        }
+    }
+
+    /// <summary>
+    /// Stop the background thread; blocks that were read ahead are dropped.
+    /// </summary>
+    ~read_ahead() {
+        {
+            std::lock_guard lock(_mutex);
+            _stopping = true;
+        }
+        _changed.notify_all();
+        if (_worker.joinable()) {
+            _worker.join();
+        }
+    }
+
+    read_ahead(const read_ahead&) = delete;
+    read_ahead& operator=(const read_ahead&) = delete;
+
+    /// <summary>
+    /// Swap the next block into the given one, handing the old buffer back for reuse.
+    /// Waits for the background thread if nothing is prefetched yet.
+    /// </summary>
+    /// <returns>false at the end of the data.</returns>
+    bool next(io_block& block) {
+        if (_queue_depth == 0) {
+            return _read_block(block);
+        }
+        std::unique_lock lock(_mutex);
+        _changed.wait(lock, [this] { return !_filled.empty() || _finished; });
+        if (_filled.empty()) {
+            if (_error) {
+                std::rethrow_exception(_error);
+            }
+            return false;
+        }
+        std::swap(block, _filled.front());
+        _spare.push_back(std::move(_filled.front()));
+        _filled.pop_front();
+        lock.unlock();
+        _changed.notify_all();
+        return true;
+    }
+
+private:
+    void produce() {
+        try {
+            while (true) {
+                io_block block;
+                {
+                    std::unique_lock lock(_mutex);
+                    _changed.wait(lock, [this] { return _stopping || _filled.size() < _queue_depth; });
+                    if (_stopping) {
+                        break;
+                    }
+                    if (!_spare.empty()) {
+                        block = std::move(_spare.back());
+                        _spare.pop_back();
+                    }
+                }
+                if (!_read_block(block)) {
+                    break;
+                }
+                {
+                    std::lock_guard lock(_mutex);
+                    _filled.push_back(std::move(block));
+                }
+                _changed.notify_all();
+            }
+        } catch (...) {
+            std::lock_guard lock(_mutex);
+            _error = std::current_exception();
+        }
+        {
+            std::lock_guard lock(_mutex);
+            _finished = true;
+        }
+        _changed.notify_all();
+    }
+
+    read_fn _read_block;
+    std::size_t _queue_depth;
+    std::deque<io_block> _filled;
+    std::vector<io_block> _spare;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::exception_ptr _error;
+    bool _stopping = false;
+    bool _finished = false;
+    std::thread _worker; // started last, after all state it uses
+};
+
+/// <summary>
+/// Write-behind block sink: submitted blocks are written by a background thread while the
+/// caller fills the next one; at most queue_depth blocks wait for the disk before submit() blocks.
+/// With queue_depth 0 submit() writes synchronously on the calling thread.
+/// The first exception thrown by write_block is rethrown by every later submit() and finish().
+/// </summary>
+class write_behind {
+public:
+    /// <summary>
+    /// Writes one complete block.
+    /// </summary>
+    using write_fn = std::function<void(const io_block&)>;
+
+    /// <summary>
+    /// Start the writer; write_block must stay callable until finish() returned or this object is destroyed.
+    /// </summary>
+    /// <param name="write_block">Writes one block, called on the background thread.</param>
+    /// <param name="queue_depth">Number of blocks queued for writing; 0 disables the background thread.</param>
+    write_behind(write_fn write_block, std::size_t queue_depth)
+        : _write_block(std::move(write_block)), _queue_depth(queue_depth) {
+        if (_queue_depth > 0) {
+            _worker = std::thread([this] { consume(); });
+        }
+    }
+
+    /// <summary>
+    /// Write the queued blocks and stop; errors are swallowed, call finish() to detect them.
+    /// </summary>
+    ~write_behind() {
+        try {
+            finish();
+        } catch (...) {
+        }
+    }
+
+    write_behind(const write_behind&) = delete;
+    write_behind& operator=(const write_behind&) = delete;
+
+    /// <summary>
+    /// Queue the block for writing and replace it with an empty buffer to fill next.
+    /// </summary>
+    void submit(io_block& block) {
+        if (_queue_depth == 0) {
+            _write_block(block);
+            block.clear();
+            return;
+        }
+        std::unique_lock lock(_mutex);
+        _changed.wait(lock, [this] { return _queued.size() < _queue_depth || _error; });
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+        io_block next;
+        if (!_spare.empty()) {
+            next = std::move(_spare.back());
+            _spare.pop_back();
+        }
+        _queued.push_back(std::move(block));
+        block = std::move(next);
+        block.clear();
+        lock.unlock();
+        _changed.notify_all();
+    }
+
+    /// <summary>
+    /// Wait until every submitted block is written and stop the background thread.
+    /// </summary>
+    void finish() {
+        {
+            std::lock_guard lock(_mutex);
+            _stopping = true;
+        }
+        _changed.notify_all();
+        if (_worker.joinable()) {
+            _worker.join();
+        }
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+    }
+
+private:
+    void consume() {
+        while (true) {
+            io_block block;
+            {
+                std::unique_lock lock(_mutex);
+                _changed.wait(lock, [this] { return _stopping || !_queued.empty(); });
+                if (_queued.empty()) {
+                    return; // only reached when stopping and all blocks are written
+                }
+                block = std::move(_queued.front());
+                _queued.pop_front();
+            }
+            try {
+                _write_block(block);
+            } catch (...) {
+                std::lock_guard lock(_mutex);
+                _error = std::current_exception();
+                _queued.clear(); // later blocks would leave a gap in the file
+            }
+            {
+                std::lock_guard lock(_mutex);
+                _spare.push_back(std::move(block));
+            }
+            _changed.notify_all();
+        }
+    }
+
+    write_fn _write_block;
+    std::size_t _queue_depth;
+    std::deque<io_block> _queued;
+    std::vector<io_block> _spare;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::exception_ptr _error;
+    bool _stopping = false;
+    std::thread _worker; // started last, after all state it uses
+};
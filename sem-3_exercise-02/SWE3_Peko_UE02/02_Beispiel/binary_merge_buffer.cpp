@@ -0,0 +1,485 @@
+#pragma once
+
+#include "merge_sort.hpp"
+#include "file_manipulator.h"
+#include "async_block_io.h"
+#include "block_codec.h"
+#include "durable_file.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Declare beforehand
+template<typename T> class BinaryMergeReader;
+template<typename T> class BinaryMergeWriter;
+template<typename T> class MappedMergeReader;
+
+/// <summary>
+/// Layout of binary run files, written in native byte order (scratch files never leave the machine):
+///   file header:  4 byte magic "MRUN", 1 byte version, 1 byte flags, 2 bytes reserved
+///   blocks:       block_header followed by payload_bytes of records
+///   record:       uint32 length followed by length bytes
+/// Records are never split across blocks; a record larger than the block size gets a block of its own.
+/// With flag_compressed the payload of every block is stored packed (see pack), payload_bytes and the
+/// checksum then refer to the stored bytes.
+/// </summary>
+namespace run_format {
+    constexpr std::array<char, 4> magic = {'M', 'R', 'U', 'N'};
+    constexpr std::uint8_t version = 1;
+
+    /// <summary>
+    /// Flag: every block carries the CRC-32 of its payload.
+    /// </summary>
+    constexpr std::uint8_t flag_checksums = 1;
+
+    /// <summary>
+    /// Flag: block payloads are compressed with block_codec.
+    /// </summary>
+    constexpr std::uint8_t flag_compressed = 2;
+
+    /// <summary>
+    /// Default payload bytes per block.
+    /// </summary>
+    constexpr std::size_t default_block_size = std::size_t{1} << 20;
+
+    /// <summary>
+    /// Default number of blocks read ahead or written behind by a background thread (double buffering).
+    /// 0 makes all I/O synchronous.
+    /// </summary>
+    constexpr std::size_t default_queue_depth = 2;
+
+    struct file_header {
+        std::array<char, 4> magic;
+        std::uint8_t version;
+        std::uint8_t flags;
+        std::uint16_t reserved;
+    };
+
+    struct block_header {
+        std::uint32_t payload_bytes;
+        std::uint32_t record_count;
+        std::uint32_t checksum; // 0 unless flag_checksums is set
+    };
+
+    /// <summary>
+    /// CRC-32 (IEEE 802.3, reflected) of a byte range.
+    /// </summary>
+    inline std::uint32_t crc32(const char* data, std::size_t size) {
+        static const auto table = [] {
+            std::array<std::uint32_t, 256> t{};
+            for (std::uint32_t i = 0; i < 256; i++) {
+                std::uint32_t c = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                t[i] = c;
+            }
+            return t;
+        }();
+        std::uint32_t crc = 0xFFFFFFFFu;
+        for (std::size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ static_cast<std::uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+        }
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    /// <summary>
+    /// Append the stored form of a compressed block's payload to out: uint32 raw size followed by the
+    /// block_codec output, or by the raw bytes themselves if they do not shrink (stored size 4 + raw size).
+    /// </summary>
+    inline void pack(const char* payload, std::uint32_t raw_bytes, std::vector<char>& out) {
+        std::size_t const start = out.size();
+        out.resize(start + sizeof(raw_bytes) + block_codec::max_compressed_size(raw_bytes));
+        char* stored = out.data() + start;
+        std::memcpy(stored, &raw_bytes, sizeof(raw_bytes));
+        std::size_t size = block_codec::compress(payload, raw_bytes, stored + sizeof(raw_bytes));
+        if (size >= raw_bytes) {
+            std::memcpy(stored + sizeof(raw_bytes), payload, raw_bytes);
+            size = raw_bytes;
+        }
+        out.resize(start + sizeof(raw_bytes) + size);
+    }
+
+    /// <summary>
+    /// Append the payload of a compressed block to out, given its stored bytes; returns false if they are malformed.
+    /// </summary>
+    inline bool unpack(const char* stored, std::size_t stored_bytes, std::vector<char>& out) {
+        std::uint32_t raw_bytes;
+        if (stored_bytes < sizeof(raw_bytes)) {
+            return false;
+        }
+        std::memcpy(&raw_bytes, stored, sizeof(raw_bytes));
+        stored += sizeof(raw_bytes);
+        stored_bytes -= sizeof(raw_bytes);
+        std::size_t const start = out.size();
+        out.resize(start + raw_bytes);
+        if (stored_bytes == raw_bytes) {
+            std::memcpy(out.data() + start, stored, raw_bytes);
+            return true;
+        }
+        return block_codec::decompress(stored, stored_bytes, out.data() + start, raw_bytes);
+    }
+}
+
+/// <summary>
+/// IMergeReader implementation for binary run files; reads a whole block at a time
+/// and slices the records out of it without any parsing. Views point into the current block:
+/// get() hands out views valid until the next advance(), next_batch() those of one block, valid until the next call.
+/// Blocks are prefetched and verified by a background thread (see read_ahead).
+/// Throws std::runtime_error on malformed files and on checksum mismatches.
+/// </summary>
+template<typename T>
+class BinaryMergeReader : public IMergeReader<T> {
+    static_assert(std::is_constructible_v<T, std::string_view>, "BinaryMergeReader: T must be constructible from std::string_view");
+
+private:
+    std::string _filename;
+    std::size_t _block_size;
+    std::size_t _queue_depth;
+    bool _checksums = false;
+    bool _compressed = false;
+    bool _durable;
+    std::unique_ptr<std::ifstream> _sacred_file_portal;
+    io_block _block; // block_header followed by the payload
+    io_block _stored; // stored bytes of a compressed block, used by the prefetch thread
+    std::size_t _block_offset = 0;
+    std::uint32_t _records_left = 0;
+    std::string_view _current;
+    bool _has_current = false;
+    bool _advance_pending = false; // _current was handed out by next_batch(), the next record is not loaded yet
+    // Declared last, so its thread is stopped before the stream and buffers it reads into are destroyed
+    std::unique_ptr<read_ahead> _prefetcher;
+
+public:
+    /// <summary>
+    /// Open a binary run file; throws if it cannot be opened or has no valid header.
+    /// </summary>
+    /// <param name="filename">Path to the run file.</param>
+    /// <param name="block_size">Block size used when converting into a writer.</param>
+    /// <param name="queue_depth">Blocks read ahead in the background; 0 reads synchronously.</param>
+    /// <param name="durable">Make the writer returned by into_writer() durable.</param>
+    explicit BinaryMergeReader(const std::string& filename, std::size_t block_size = run_format::default_block_size,
+                               std::size_t queue_depth = run_format::default_queue_depth, bool durable = false)
+        : _filename(filename), _block_size(block_size), _queue_depth(queue_depth), _durable(durable) {
+        _sacred_file_portal = std::make_unique<std::ifstream>(filename, std::ios::binary);
+        if (!_sacred_file_portal->is_open()) {
+            throw std::runtime_error("BinaryMergeReader: cannot open file for reading: " + filename);
+        }
+        run_format::file_header header{};
+        if (!_sacred_file_portal->read(reinterpret_cast<char*>(&header), sizeof(header))
+            || header.magic != run_format::magic || header.version != run_format::version) {
+            throw std::runtime_error("BinaryMergeReader: not a binary run file: " + filename);
+        }
+        _checksums = (header.flags & run_format::flag_checksums) != 0;
+        _compressed = (header.flags & run_format::flag_compressed) != 0;
+        _prefetcher = std::make_unique<read_ahead>([this](io_block& block) { return read_block(block); }, _queue_depth);
+        load_next();
+    }
+
+    /// <summary>
+    /// Return current record without consuming; throws on exhaustion.
+    /// </summary>
+    T get() override {
+        if (is_exhausted()) {
+            throw std::underflow_error("No more elements to read");
+        }
+        return T(_current);
+    }
+
+    /// <summary>
+    /// Consume current record and advance; returns whether another record is available.
+    /// </summary>
+    bool advance() override {
+        if (is_exhausted()) {
+            return false;
+        }
+        load_next();
+        return _has_current;
+    }
+
+    /// <summary>
+    /// True if no further records are available.
+    /// </summary>
+    bool is_exhausted() override {
+        settle();
+        return !_has_current;
+    }
+
+    /// <summary>
+    /// Copy records until out is full or the current block ends; loading the next block waits for the next call.
+    /// </summary>
+    std::size_t next_batch(std::span<T> out) override {
+        settle();
+        std::size_t count = 0;
+        while (count < out.size() && _has_current) {
+            out[count++] = T(_current);
+            if (_records_left == 0) {
+                _advance_pending = true;
+                break;
+            }
+            load_next();
+        }
+        return count;
+    }
+
+    /// <summary>
+    /// Close reader and return a writer truncating the same file.
+    /// </summary>
+    std::unique_ptr<IMergeWriter<T>> into_writer() override {
+        _prefetcher.reset(); // stops the background thread before the stream goes away
+        _sacred_file_portal->close();
+        _sacred_file_portal.reset();
+        _has_current = false;
+        _advance_pending = false;
+        return std::make_unique<BinaryMergeWriter<T>>(_filename, _block_size, _checksums, _queue_depth, _compressed, _durable);
+    }
+
+private:
+    /// <summary>
+    /// Position _current on the next record, reading the next block if the current one is used up.
+    /// </summary>
+    void load_next() {
+        while (_records_left == 0) {
+            if (!_prefetcher->next(_block)) {
+                _has_current = false;
+                return;
+            }
+            run_format::block_header header;
+            std::memcpy(&header, _block.data(), sizeof(header));
+            _block_offset = sizeof(header);
+            _records_left = header.record_count;
+        }
+        std::uint32_t length;
+        if (_block.size() - _block_offset < sizeof(length)) {
+            throw std::runtime_error("BinaryMergeReader: truncated record in " + _filename);
+        }
+        std::memcpy(&length, _block.data() + _block_offset, sizeof(length));
+        _block_offset += sizeof(length);
+        if (_block.size() - _block_offset < length) {
+            throw std::runtime_error("BinaryMergeReader: truncated record in " + _filename);
+        }
+        _current = std::string_view(_block.data() + _block_offset, length);
+        _block_offset += length;
+        _records_left--;
+        _has_current = true;
+    }
+
+    void settle() {
+        if (_advance_pending) {
+            _advance_pending = false;
+            load_next();
+        }
+    }
+
+    /// <summary>
+    /// Read the next block with its header into block, decompressing its payload; runs on the prefetch thread.
+    /// </summary>
+    bool read_block(io_block& block) {
+        run_format::block_header header{};
+        if (!_sacred_file_portal->read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            return false; // clean end of file
+        }
+        io_block& stored = _compressed ? _stored : block;
+        std::size_t const offset = _compressed ? 0 : sizeof(header);
+        stored.resize(offset + header.payload_bytes);
+        if (!_sacred_file_portal->read(stored.data() + offset, header.payload_bytes)) {
+            throw std::runtime_error("BinaryMergeReader: truncated block in " + _filename);
+        }
+        if (_checksums && run_format::crc32(stored.data() + offset, header.payload_bytes) != header.checksum) {
+            throw std::runtime_error("BinaryMergeReader: checksum mismatch in " + _filename);
+        }
+        if (_compressed) {
+            block.resize(sizeof(header));
+            if (!run_format::unpack(_stored.data(), _stored.size(), block)) {
+                throw std::runtime_error("BinaryMergeReader: corrupt compressed block in " + _filename);
+            }
+            header.payload_bytes = static_cast<std::uint32_t>(block.size() - sizeof(header));
+        }
+        std::memcpy(block.data(), &header, sizeof(header));
+        return true;
+    }
+};
+
+/// <summary>
+/// IMergeWriter implementation for binary run files; collects length-prefixed records
+/// in a block buffer and writes each full block with a single call.
+/// Full blocks are written behind by a background thread (see write_behind) while the next one fills.
+/// </summary>
+template<typename T>
+class BinaryMergeWriter : public IMergeWriter<T> {
+private:
+    std::string _filename;
+    std::size_t _block_size;
+    bool _checksums;
+    std::size_t _queue_depth;
+    bool _compressed;
+    bool _durable;
+    std::unique_ptr<durable_output> _sacred_file_portal;
+    io_block _block; // room for the block_header followed by the payload
+    io_block _packed; // compressed block, used by the write-behind thread
+    std::uint32_t _record_count = 0;
+    // Declared last, so its thread is stopped before the stream and buffers it writes from are destroyed
+    std::unique_ptr<write_behind> _scribe;
+
+public:
+    /// <summary>
+    /// Create or truncate a binary run file; throws if file cannot be opened.
+    /// </summary>
+    /// <param name="filename">Path to output file.</param>
+    /// <param name="block_size">Payload bytes collected before a block is written.</param>
+    /// <param name="checksums">Store a CRC-32 per block, verified by the reader.</param>
+    /// <param name="queue_depth">Blocks queued for the background writer; 0 writes synchronously.</param>
+    /// <param name="compressed">Compress every block with block_codec on the background writer.</param>
+    /// <param name="durable">Flush the file to the disk in into_reader() before it is closed, so it survives a crash.</param>
+    explicit BinaryMergeWriter(const std::string& filename, std::size_t block_size = run_format::default_block_size, bool checksums = false,
+                               std::size_t queue_depth = run_format::default_queue_depth, bool compressed = false, bool durable = false)
+        : _filename(filename), _block_size(block_size), _checksums(checksums), _queue_depth(queue_depth), _compressed(compressed), _durable(durable) {
+        file_manipulator::delete_file(filename);
+        _sacred_file_portal = std::make_unique<durable_output>(filename); // throws if file cannot be opened
+        std::uint8_t const flags = (checksums ? run_format::flag_checksums : 0) | (compressed ? run_format::flag_compressed : 0);
+        run_format::file_header header{run_format::magic, run_format::version, flags, 0};
+        if (!_sacred_file_portal->write(reinterpret_cast<const char*>(&header), sizeof(header))) {
+            throw std::runtime_error("BinaryMergeWriter: writing failed: " + filename);
+        }
+        _scribe = std::make_unique<write_behind>([this](const io_block& block) { write_block(block); }, _queue_depth);
+        start_block();
+    }
+
+    /// <summary>
+    /// Pending records are flushed, errors are swallowed; call into_reader() to detect them.
+    /// </summary>
+    ~BinaryMergeWriter() override {
+        try {
+            if (_sacred_file_portal) {
+                flush_block();
+                _scribe.reset(); // writes the queued blocks before the stream goes away
+            }
+        } catch (...) {
+        }
+    }
+
+    /// <summary>
+    /// Append record to the current block; returns false if stream not open.
+    /// </summary>
+    bool append(const T& value) override {
+        if (!_sacred_file_portal || !_sacred_file_portal->is_open()) {
+            return false;
+        }
+        add_record(value);
+        return true;
+    }
+
+    /// <summary>
+    /// Append records to the current block without a virtual call per record; returns false if stream not open.
+    /// </summary>
+    bool append_batch(std::span<const T> values) override {
+        if (!_sacred_file_portal || !_sacred_file_portal->is_open()) {
+            return false;
+        }
+        for (const T& value : values) {
+            add_record(value);
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// True if into_reader() flushes the file to the disk.
+    /// </summary>
+    bool durable() const {
+        return _durable;
+    }
+
+    /// <summary>
+    /// Flush, close writer and return a reader for the same file; throws if writing failed.
+    /// A durable writer flushes the file to the disk first, through its own handle, and the reader recycles into a durable writer.
+    /// Views are read zero-copy from a memory mapping, owning types through a block buffer.
+    /// </summary>
+    std::unique_ptr<IMergeReader<T>> into_reader() override {
+        flush_block();
+        _scribe->finish(); // rethrows errors of the background writer
+        _scribe.reset();
+        if (_durable) {
+            _sacred_file_portal->sync();
+        }
+        bool const failed = !_sacred_file_portal->close();
+        _sacred_file_portal.reset();
+        if (failed) {
+            throw std::runtime_error("BinaryMergeWriter: writing failed: " + _filename);
+        }
+        if constexpr (std::is_same_v<T, std::string_view>) {
+            return std::make_unique<MappedMergeReader<T>>(_filename, _block_size, _queue_depth, _durable);
+        } else {
+            return std::make_unique<BinaryMergeReader<T>>(_filename, _block_size, _queue_depth, _durable);
+        }
+    }
+
+private:
+    void add_record(std::string_view bytes) {
+        std::uint32_t const length = static_cast<std::uint32_t>(bytes.size());
+        if (_record_count > 0 && payload_bytes() + sizeof(length) + bytes.size() > _block_size) {
+            flush_block();
+        }
+        char prefix[sizeof(length)];
+        std::memcpy(prefix, &length, sizeof(length));
+        _block.insert(_block.end(), prefix, prefix + sizeof(length));
+        _block.insert(_block.end(), bytes.begin(), bytes.end());
+        _record_count++;
+    }
+
+    std::size_t payload_bytes() const {
+        return _block.size() - sizeof(run_format::block_header);
+    }
+
+    void start_block() {
+        _block.reserve(sizeof(run_format::block_header) + _block_size);
+        _block.resize(sizeof(run_format::block_header));
+        _record_count = 0;
+    }
+
+    /// <summary>
+    /// Fill in the block header and hand the block to the background writer.
+    /// </summary>
+    void flush_block() {
+        if (_record_count == 0) {
+            return;
+        }
+        const char* payload = _block.data() + sizeof(run_format::block_header);
+        run_format::block_header header{
+            static_cast<std::uint32_t>(payload_bytes()),
+            _record_count,
+            _checksums && !_compressed ? run_format::crc32(payload, payload_bytes()) : 0}; // compressed: see write_block
+        std::memcpy(_block.data(), &header, sizeof(header));
+        _scribe->submit(_block);
+        start_block();
+    }
+
+    /// <summary>
+    /// Write one block, compressing its payload first if requested; runs on the write-behind thread.
+    /// </summary>
+    void write_block(const io_block& block) {
+        const io_block* out = &block;
+        if (_compressed) {
+            run_format::block_header header;
+            std::memcpy(&header, block.data(), sizeof(header));
+            _packed.resize(sizeof(header));
+            run_format::pack(block.data() + sizeof(header), header.payload_bytes, _packed);
+            header.payload_bytes = static_cast<std::uint32_t>(_packed.size() - sizeof(header));
+            header.checksum = _checksums ? run_format::crc32(_packed.data() + sizeof(header), header.payload_bytes) : 0;
+            std::memcpy(_packed.data(), &header, sizeof(header));
+            out = &_packed;
+        }
+        if (!_sacred_file_portal->write(out->data(), out->size())) {
+            throw std::runtime_error("BinaryMergeWriter: writing failed: " + _filename);
+        }
+    }
+};
+
+// MappedMergeReader is needed by BinaryMergeWriter<std::string_view>::into_reader
+#include "mapped_merge_buffer.cpp"
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// <summary>
+/// Lightweight LZ77 block compression in the LZ4 block format: a sequence of
+///   token:    4 bits literal count, 4 bits match length - 4 (15 = more length bytes follow)
+///   literals: literal count bytes copied as they are
+///   offset:   2 bytes little endian distance back to the match (absent after the last literals)
+/// Lengths of 15 or more continue in bytes of 255 up to a final byte below 255.
+/// Matches are found through a hash table of 4 byte sequences, so compression is a single cheap pass
+/// and decompression just copies; text with repeated or shared substrings (sorted runs) shrinks well.
+/// </summary>
+namespace block_codec {
+    /// <summary>
+    /// Largest possible output of compress for size input bytes.
+    /// </summary>
+    constexpr std::size_t max_compressed_size(std::size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    namespace detail {
+        constexpr std::size_t min_match = 4;
+        constexpr std::size_t max_offset = 65535;
+        constexpr int hash_bits = 14;
+
+        inline std::uint32_t read32(const char* p) {
+            std::uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        inline std::uint64_t read64(const char* p) {
+            std::uint64_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        /// <summary>
+        /// End of the common bytes of p and ref, up to limit; compares 8 bytes at a time.
+        /// </summary>
+        inline const char* extend_match(const char* p, const char* ref, const char* limit) {
+            while (limit - p >= 8) {
+                std::uint64_t const diff = read64(p) ^ read64(ref);
+                if (diff != 0) {
+                    if constexpr (std::endian::native == std::endian::little) {
+                        return p + std::countr_zero(diff) / 8;
+                    } else {
+                        return p + std::countl_zero(diff) / 8;
+                    }
+                }
+                p += 8;
+                ref += 8;
+            }
+            while (p < limit && *p == *ref) {
+                ++p;
+                ++ref;
+            }
+            return p;
+        }
+
+        inline std::uint32_t hash(std::uint32_t sequence) {
+            return (sequence * 2654435761u) >> (32 - hash_bits);
+        }
+
+        inline char* write_length(char* out, std::size_t length) {
+            for (; length >= 255; length -= 255) {
+                *out++ = static_cast<char>(255);
+            }
+            *out++ = static_cast<char>(length);
+            return out;
+        }
+
+        inline bool read_length(const unsigned char*& in, const unsigned char* end, std::size_t& length) {
+            unsigned char byte;
+            do {
+                if (in == end) {
+                    return false;
+                }
+                byte = *in++;
+                length += byte;
+            } while (byte == 255);
+            return true;
+        }
+
+        /// <summary>
+        /// Write literals followed by a match, or the literals alone for match_length 0 (last sequence).
+        /// </summary>
+        inline char* write_sequence(char* out, const char* literals, std::size_t literal_count, std::size_t offset, std::size_t match_length) {
+            char* token = out++;
+            std::size_t const match_code = match_length > 0 ? match_length - min_match : 0;
+            *token = static_cast<char>(((literal_count < 15 ? literal_count : 15) << 4) | (match_code < 15 ? match_code : 15));
+            if (literal_count >= 15) {
+                out = write_length(out, literal_count - 15);
+            }
+            std::memcpy(out, literals, literal_count);
+            out += literal_count;
+            if (match_length > 0) {
+                *out++ = static_cast<char>(offset & 0xFF);
+                *out++ = static_cast<char>(offset >> 8);
+                if (match_code >= 15) {
+                    out = write_length(out, match_code - 15);
+                }
+            }
+            return out;
+        }
+    }
+
+    /// <summary>
+    /// Compress size bytes of input into out, which must hold max_compressed_size(size) bytes.
+    /// Returns the number of bytes written.
+    /// </summary>
+    inline std::size_t compress(const char* input, std::size_t size, char* out) {
+        using namespace detail;
+        char* const start = out;
+        const char* const end = input + size;
+        const char* anchor = input; // first byte not yet written
+        if (size > 12) {
+            // Positions of the last 4 byte sequences seen with each hash; 0 is only a guess and verified like any other
+            std::array<std::uint32_t, std::size_t{1} << hash_bits> table{};
+            const char* const match_limit = end - 12; // the last bytes are always literals, as in LZ4
+            const char* ip = input + 1;
+            while (ip < match_limit) {
+                std::uint32_t const sequence = read32(ip);
+                std::uint32_t& slot = table[hash(sequence)];
+                const char* ref = input + slot;
+                slot = static_cast<std::uint32_t>(ip - input);
+                if (static_cast<std::size_t>(ip - ref) > max_offset || read32(ref) != sequence) {
+                    ip += 1 + ((ip - anchor) >> 6); // skip faster through data that does not compress
+                    continue;
+                }
+                const char* const match_end = extend_match(ip + min_match, ref + min_match, end - 5);
+                out = write_sequence(out, anchor, ip - anchor, ip - ref, match_end - ip);
+                ip = anchor = match_end;
+            }
+        }
+        out = write_sequence(out, anchor, end - anchor, 0, 0);
+        return out - start;
+    }
+
+    /// <summary>
+    /// Decompress size bytes written by compress into exactly raw_size bytes at out.
+    /// Returns false if the input is malformed or does not decompress to raw_size bytes.
+    /// </summary>
+    inline bool decompress(const char* input, std::size_t size, char* out, std::size_t raw_size) {
+        using namespace detail;
+        const unsigned char* in = reinterpret_cast<const unsigned char*>(input);
+        const unsigned char* const end = in + size;
+        char* const start = out;
+        char* const out_end = out + raw_size;
+        while (in < end) {
+            unsigned const token = *in++;
+            std::size_t literal_count = token >> 4;
+            if (literal_count == 15 && !read_length(in, end, literal_count)) {
+                return false;
+            }
+            if (static_cast<std::size_t>(end - in) < literal_count || static_cast<std::size_t>(out_end - out) < literal_count) {
+                return false;
+            }
+            std::memcpy(out, in, literal_count);
+            in += literal_count;
+            out += literal_count;
+            if (in == end) {
+                break; // the last sequence has no match
+            }
+
+            if (end - in < 2) {
+                return false;
+            }
+            std::size_t const offset = in[0] | (std::size_t{in[1]} << 8);
+            in += 2;
+            std::size_t match_length = token & 15;
+            if (match_length == 15 && !read_length(in, end, match_length)) {
+                return false;
+            }
+            match_length += min_match;
+            if (offset == 0 || offset > static_cast<std::size_t>(out - start) || static_cast<std::size_t>(out_end - out) < match_length) {
+                return false;
+            }
+            const char* ref = out - offset;
+            if (offset >= match_length) {
+                std::memcpy(out, ref, match_length);
+                out += match_length;
+            } else {
+                // Overlapping match: repeats the last offset bytes
+                for (std::size_t i = 0; i < match_length; i++) {
+                    *out++ = *ref++;
+                }
+            }
+        }
+        return out == out_end;
+    }
+}
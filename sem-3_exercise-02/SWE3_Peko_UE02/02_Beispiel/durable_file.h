@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// Durable file updates: flushing files to the disk and replacing a file atomically,
+/// so a crash leaves either the old or the complete new contents behind.
+/// </summary>
+namespace durable_file {
+    /// <summary>
+    /// Flush the contents of a closed file from the OS cache to the disk (fsync / FlushFileBuffers); throws on failure.
+    /// </summary>
+    inline void sync(const std::string& file_name) {
+#ifdef _WIN32
+        HANDLE const file = CreateFileA(file_name.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        bool const synced = file != INVALID_HANDLE_VALUE && FlushFileBuffers(file);
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+#else
+        int const fd = ::open(file_name.c_str(), O_RDONLY);
+        bool const synced = fd >= 0 && ::fsync(fd) == 0;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+#endif
+        if (!synced) {
+            throw std::runtime_error("durable_file: cannot flush to disk: " + file_name);
+        }
+    }
+
+    /// <summary>
+    /// Flush the entries of a directory, making renames and new files in it durable. Nothing to do on Windows.
+    /// </summary>
+    inline void sync_directory(const std::filesystem::path& directory) {
+#ifndef _WIN32
+        std::string const name = directory.empty() ? std::string(".") : directory.string();
+        int const fd = ::open(name.c_str(), O_RDONLY | O_DIRECTORY);
+        bool const synced = fd >= 0 && ::fsync(fd) == 0;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        if (!synced) {
+            throw std::runtime_error("durable_file: cannot flush directory to disk: " + name);
+        }
+#endif
+    }
+
+    /// <summary>
+    /// Move a file over another one in the same directory in a single step; throws on failure.
+    /// </summary>
+    inline void replace(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+        if (!MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+            throw std::runtime_error("durable_file: cannot replace " + to + " by " + from);
+        }
+#else
+        if (std::rename(from.c_str(), to.c_str()) != 0) {
+            throw std::runtime_error("durable_file: cannot replace " + to + " by " + from);
+        }
+        sync_directory(std::filesystem::path(to).parent_path());
+#endif
+    }
+}
+
+/// <summary>
+/// Binary output file written directly through the native handle (CreateFile / open), so it can be flushed
+/// to the disk by sync() before it is closed. Writes are unbuffered; callers write whole blocks.
+/// Other handles may read the file while it is open, none may write it.
+/// </summary>
+class durable_output {
+public:
+    /// <summary>
+    /// Create or truncate a file; throws if it cannot be opened.
+    /// </summary>
+    explicit durable_output(const std::string& file_name) : _file_name(file_name) {
+#ifdef _WIN32
+        _file = CreateFileA(file_name.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        bool const opened = _file != INVALID_HANDLE_VALUE;
+#else
+        _file = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        bool const opened = _file >= 0;
+#endif
+        if (!opened) {
+            throw std::runtime_error("durable_output: cannot open file for writing: " + file_name);
+        }
+    }
+
+    /// <summary>
+    /// Closes the file if close() was not called; errors are swallowed.
+    /// </summary>
+    ~durable_output() {
+        close();
+    }
+
+    durable_output(const durable_output&) = delete;
+    durable_output& operator=(const durable_output&) = delete;
+
+    bool is_open() const noexcept { return _open; }
+
+    /// <summary>
+    /// Append size bytes; returns false if the file is closed or writing failed.
+    /// </summary>
+    bool write(const char* data, std::size_t size) {
+        while (_open && size > 0) {
+#ifdef _WIN32
+            DWORD const chunk = static_cast<DWORD>(size < 0x40000000 ? size : 0x40000000);
+            DWORD written = 0;
+            if (!WriteFile(_file, data, chunk, &written, nullptr)) {
+                return false;
+            }
+#else
+            ssize_t const written = ::write(_file, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+#endif
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return _open;
+    }
+
+    /// <summary>
+    /// Flush everything written so far from the OS cache to the disk; throws on failure.
+    /// </summary>
+    void sync() {
+#ifdef _WIN32
+        bool const synced = _open && FlushFileBuffers(_file);
+#else
+        bool const synced = _open && ::fsync(_file) == 0;
+#endif
+        if (!synced) {
+            throw std::runtime_error("durable_output: cannot flush to disk: " + _file_name);
+        }
+    }
+
+    /// <summary>
+    /// Close the file; returns false if it was not open or closing failed.
+    /// </summary>
+    bool close() noexcept {
+        if (!_open) {
+            return false;
+        }
+        _open = false;
+#ifdef _WIN32
+        return CloseHandle(_file) != 0;
+#else
+        return ::close(_file) == 0;
+#endif
+    }
+
+private:
+    std::string _file_name;
+#ifdef _WIN32
+    HANDLE _file = INVALID_HANDLE_VALUE;
+#else
+    int _file = -1;
+#endif
+    bool _open = true;
+};
+
+/// <summary>
+/// New contents for a file, written under a temporary name next to it (path()) and moved over it by commit()
+/// once they are on the disk. Until then the target is untouched; an uncommitted temporary file is removed on destruction.
+/// </summary>
+class atomic_file {
+public:
+    /// <summary>
+    /// Prepare new contents for target; nothing is created until path() is written.
+    /// </summary>
+    explicit atomic_file(std::string target)
+        : _target(std::move(target)), _path(_target + ".partial") {
+    }
+
+    ~atomic_file() {
+        if (!_committed) {
+            std::error_code ignored;
+            std::filesystem::remove(_path, ignored);
+        }
+    }
+
+    atomic_file(const atomic_file&) = delete;
+    atomic_file& operator=(const atomic_file&) = delete;
+
+    /// <summary>
+    /// Path of the temporary file to write the new contents to.
+    /// </summary>
+    const std::string& path() const noexcept { return _path; }
+
+    /// <summary>
+    /// Flush the closed temporary file to the disk and replace the target by it; throws on failure.
+    /// </summary>
+    void commit() {
+        durable_file::sync(_path);
+        durable_file::replace(_path, _target);
+        _committed = true;
+    }
+
+private:
+    std::string _target;
+    std::string _path;
+    bool _committed = false;
+};
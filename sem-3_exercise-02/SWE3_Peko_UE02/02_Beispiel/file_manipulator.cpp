@@ -2,29 +2,196 @@
 
 #include <fstream>
 #include "random.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <future>
+#include <optional>
+#include <random>
 #include <stdexcept>
+#include <thread>
 
 using fm = file_manipulator;
 
+namespace {
+
+  /// <summary>
+  /// splitmix64: a tiny and fast PRNG, good enough for test data; also used to derive independent seeds.
+  /// </summary>
+  struct splitmix64 {
+    std::uint64_t state;
+
+    std::uint64_t operator()() {
+      std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return z ^ (z >> 31);
+    }
+
+    /// uniform in [0, 1)
+    double real() {
+      return static_cast<double>((*this)() >> 11) * 0x1.0p-53;
+    }
+  };
+
+  /// <summary>
+  /// Uniform letters 'A'..'Z', two from every 64 bit draw.
+  /// </summary>
+  void fill_letters(char* out, std::size_t len, splitmix64& rng) {
+    for (std::size_t i = 0; i < len; i += 2) {
+      std::uint64_t const bits = rng();
+      out[i] = static_cast<char>('A' + ((bits & 0xFFFFFFFFu) * 26 >> 32));
+      if (i + 1 < len) {
+        out[i + 1] = static_cast<char>('A' + ((bits >> 32) * 26 >> 32));
+      }
+    }
+  }
+
+  /// <summary>
+  /// The i-th of count ascending tokens, spread evenly over the first (at most 13) letters, the others are 'A'.
+  /// Rounding is monotonic, so the tokens never descend, whichever thread writes them.
+  /// </summary>
+  void fill_ascending(char* out, std::size_t len, std::size_t i, std::size_t count) {
+    std::size_t const digits = std::min<std::size_t>(len, 13); // 26^13 < 2^64
+    std::uint64_t space = 1;
+    for (std::size_t d = 0; d < digits; d++) {
+      space *= 26;
+    }
+    double const position = static_cast<double>(i) / static_cast<double>(count) * static_cast<double>(space);
+    std::uint64_t value = std::min(static_cast<std::uint64_t>(position), space - 1);
+    for (std::size_t d = digits; d-- > 0;) {
+      out[d] = static_cast<char>('A' + value % 26);
+      value /= 26;
+    }
+    std::fill(out + digits, out + len, 'A');
+  }
+
+  /// <summary>
+  /// Sampler of the ranks 0 .. vocabulary - 1 under a zipf distribution, by inversion of the cumulative
+  /// probabilities. A guide table points every draw close to its rank, so sampling takes O(1) expected steps.
+  /// </summary>
+  class zipf_table {
+  public:
+    zipf_table(std::size_t vocabulary, double exponent) : _cdf(vocabulary), _guide(vocabulary) {
+      double sum = 0;
+      for (std::size_t rank = 0; rank < vocabulary; rank++) {
+        sum += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+        _cdf[rank] = sum;
+      }
+      for (double& p : _cdf) {
+        p /= sum;
+      }
+      _cdf.back() = 1.0;
+      // _guide[j] is the first rank whose cumulative probability exceeds j / vocabulary
+      std::size_t rank = 0;
+      for (std::size_t j = 0; j < vocabulary; j++) {
+        while (_cdf[rank] <= static_cast<double>(j) / static_cast<double>(vocabulary)) {
+          rank++;
+        }
+        _guide[j] = rank;
+      }
+    }
+
+    /// rank for a uniform draw u in [0, 1)
+    std::size_t sample(double u) const {
+      std::size_t const bucket = std::min(static_cast<std::size_t>(u * static_cast<double>(_guide.size())), _guide.size() - 1);
+      std::size_t rank = _guide[bucket];
+      while (_cdf[rank] <= u) {
+        rank++;
+      }
+      return rank;
+    }
+
+  private:
+    std::vector<double> _cdf;
+    std::vector<std::size_t> _guide;
+  };
+
+}
+
 void fm::delete_file(std::string const& file_name) {
   std::remove(file_name.c_str());
 }
 
 
 void fm::fill_randomly(std::string const& file_name, size_type n, size_type len) {
-    std::ofstream out(file_name);
-    if (!out.is_open()) {
-        throw std::runtime_error("file_manipulator::fill_randomly: cannot open file for writing: " + file_name);
+    std::random_device random_dev{};
+    fill_options options;
+    options.seed = (std::uint64_t{random_dev()} << 32) | random_dev();
+    fill_bulk(file_name, n, len, options);
+}
+
+
+void fm::fill_bulk(std::string const& file_name, size_type n, size_type len, fill_options const& options) {
+    bool const zipf = options.dist == distribution::zipf;
+    if (zipf && options.vocabulary == 0) {
+        throw std::invalid_argument("file_manipulator::fill_bulk: the zipf distribution needs a vocabulary");
     }
+    {
+        std::ofstream out(file_name, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("file_manipulator::fill_bulk: cannot open file for writing: " + file_name);
+        }
+    }
+    size_type const token_bytes = len + 1;
+    std::filesystem::resize_file(file_name, n * token_bytes);
 
-    while (out && (n-- > 0)) {
-        append(out, random_string(len));
+    // Chunks only depend on n and len and every chunk seeds its own generator,
+    // so the file is the same for any number of threads
+    size_type const chunk_tokens = std::max<size_type>(1, (size_type{1} << 20) / token_bytes);
+    size_type const chunks = (n + chunk_tokens - 1) / chunk_tokens;
+    size_type const sorted_tokens = static_cast<size_type>(std::clamp(options.presorted_fraction, 0.0, 1.0) * static_cast<double>(n));
+    std::optional<zipf_table> zipf_ranks;
+    if (zipf) {
+      zipf_ranks.emplace(options.vocabulary, options.zipf_exponent);
+    }
+    std::uint64_t const vocabulary_seed = splitmix64{options.seed}();
+    size_type const hardware = std::max(1u, std::thread::hardware_concurrency());
+    size_type const threads = std::max<size_type>(1, std::min(options.threads == 0 ? hardware : options.threads, chunks));
+
+    auto generate = [&](size_type first_chunk) {
+        std::fstream file(file_name, std::ios::in | std::ios::out | std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("file_manipulator::fill_bulk: cannot open file for writing: " + file_name);
+        }
+        std::vector<char> block;
+        for (size_type chunk = first_chunk; chunk < chunks; chunk += threads) {
+            size_type const begin = chunk * chunk_tokens;
+            size_type const end = std::min(n, begin + chunk_tokens);
+            block.resize((end - begin) * token_bytes);
+            splitmix64 rng{splitmix64{options.seed ^ splitmix64{chunk}()}()};
+            char* out = block.data();
+            for (size_type i = begin; i < end; i++, out += token_bytes) {
+                if (i < sorted_tokens) {
+                    fill_ascending(out, len, i, sorted_tokens);
+                } else if (zipf) {
+                    // The token of a rank is generated from the rank alone, so it is the same everywhere
+                    splitmix64 token_rng{vocabulary_seed ^ splitmix64{zipf_ranks->sample(rng.real())}()};
+                    fill_letters(out, len, token_rng);
+                } else {
+                    fill_letters(out, len, rng);
+                }
+                out[len] = ' ';
+            }
+            file.seekp(static_cast<std::streamoff>(begin * token_bytes));
+            file.write(block.data(), static_cast<std::streamsize>(block.size()));
+        }
+        if (!file) {
+            throw std::runtime_error("file_manipulator::fill_bulk: cannot write file: " + file_name);
+        }
+    };
+
+    std::vector<std::future<void>> workers;
+    for (size_type t = 0; t < threads; t++) {
+        workers.push_back(std::async(std::launch::async, generate, t));
+    }
+    for (auto& worker : workers) {
+        worker.get(); // rethrows errors of the workers
     }
-    out.close();
 }
 
 
-void fm::append(std::ofstream& file, std::string const& str) {
+void fm::append(std::ofstream& file, std::string_view str) {
   if (!file.is_open()) {
     throw std::runtime_error("file_manipulator::append: file stream is not open");
   }
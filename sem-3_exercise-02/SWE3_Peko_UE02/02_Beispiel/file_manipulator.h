@@ -1,7 +1,9 @@
 // @@ -0,0 +1,57 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <vector>
 
@@ -15,6 +17,31 @@ public:
   /// </summary>
   using value_type = std::string;
 
+  /// <summary>
+  /// How fill_bulk draws its tokens.
+  /// </summary>
+  enum class distribution {
+    uniform, // every character uniformly from 'A'..'Z'
+    zipf,    // tokens of a fixed vocabulary, the k-th most frequent one with probability ~ 1 / k^zipf_exponent
+  };
+
+  /// <summary>
+  /// Settings of fill_bulk.
+  /// </summary>
+  struct fill_options {
+    distribution dist = distribution::uniform;
+    /// Distinct tokens of the zipf distribution.
+    size_type vocabulary = 100000;
+    /// Skew of the zipf distribution; 0 makes all tokens of the vocabulary equally likely.
+    double zipf_exponent = 1.0;
+    /// Share of the tokens at the start of the file that are in ascending order, between 0 and 1.
+    double presorted_fraction = 0.0;
+    /// Equal seeds produce equal files (for equal n, len and options), whatever the number of threads.
+    std::uint64_t seed = 0;
+    /// Threads generating and writing disjoint regions of the file; 0 uses one per hardware thread.
+    size_type threads = 0;
+  };
+
   /// <summary>
   /// Delete a file.
   /// </summary>
@@ -23,18 +50,30 @@ public:
 
   /// <summary>
   /// Create a file, filled n strings of size len. If the file exists, it will be overwritten.
+  /// Generated by fill_bulk with uniform tokens and a random seed.
   /// </summary>
   /// <param name="file_name">name of the destination file</param>
   /// <param name="n">number of elements</param>
   /// <param name="len">length of each element</param>
   static void fill_randomly(std::string const& file_name, size_type n = 100, size_type len = 4);
 
+  /// <summary>
+  /// Create a file of n strings of size len, each followed by a space. If the file exists, it will be overwritten.
+  /// Tokens are generated straight into large blocks by a fast seedable PRNG; as token i starts at byte i * (len + 1),
+  /// several threads generate and write disjoint regions of the file at once.
+  /// </summary>
+  /// <param name="file_name">name of the destination file</param>
+  /// <param name="n">number of elements</param>
+  /// <param name="len">length of each element</param>
+  /// <param name="options">distribution, seed and threads</param>
+  static void fill_bulk(std::string const& file_name, size_type n, size_type len, fill_options const& options);
+
   /// <summary>
   /// Append a string to a file.
   /// </summary>
   /// <param name="file">open output file stream</param>
   /// <param name="str">string to append to the file</param>
-  static void append(std::ofstream& file, std::string const& str);
+  static void append(std::ofstream& file, std::string_view str);
 
   /// <summary>
   /// Read contents of type value_type from a file and print it to a stream (default std::cout).
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "merge_sort.hpp"
-#include "stream_reader.h"
+#include "token_scanner.h"
 #include "file_manipulator.h"
 
 #include <fstream>
@@ -11,14 +11,19 @@ template<typename T> class FileMergeReader;
 template<typename T> class FileMergeWriter;
 
 /// <summary>
-/// IMergeReader implementation backed by a file; reads tokens via stream_reader<T>.
+/// IMergeReader implementation backed by a file; reads tokens via token_scanner.
+/// The current token is a view into the scanner's block, so T may be std::string_view:
+/// get() then returns a view that stays valid until the next advance(), next_batch() hands out
+/// the tokens of one block, valid until the next call.
 /// </summary>
 template<typename T>
 class FileMergeReader : public IMergeReader<T> {
 private:
     std::string _filename;
-    std::unique_ptr<stream_reader<T>> _gobbling_stream_gremlin;
-    std::unique_ptr<std::ifstream> _sacred_file_portal;
+    std::unique_ptr<token_scanner> _gobbling_stream_gremlin;
+    std::string_view _current;
+    bool _has_current = false;
+    bool _advance_pending = false; // _current was handed out by next_batch(), the next token is not read yet
 
 public:
     /// <summary>
@@ -28,11 +33,12 @@ public:
     explicit FileMergeReader(const std::string& filename)
         : _filename(filename) {
         // Open source file for reading; throw if unavailable
-        _sacred_file_portal = std::make_unique<std::ifstream>(filename);
-        if (!_sacred_file_portal->is_open()) {
+        try {
+            _gobbling_stream_gremlin = std::make_unique<token_scanner>(filename);
+        } catch (const std::runtime_error&) {
             throw std::runtime_error("FileMergeReader: cannot open file for reading: " + filename);
         }
-        _gobbling_stream_gremlin = std::make_unique<stream_reader<T>>(*_sacred_file_portal);
+        load_next();
     }
 
     /// <summary>
@@ -42,7 +48,7 @@ public:
         if (is_exhausted()) {
             throw std::underflow_error("No more elements to read");
         }
-        return _gobbling_stream_gremlin->peek();
+        return T(_current);
     }
 
     /// <summary>
@@ -52,26 +58,55 @@ public:
         if (is_exhausted()) {
             return false;
         }
-        _gobbling_stream_gremlin->get(); // consume current element
-        return _gobbling_stream_gremlin->has_next();
+        load_next(); // consume current element
+        return _has_current;
     }
 
     /// <summary>
     /// True if no further tokens are available.
     /// </summary>
     bool is_exhausted() override {
-        return !_gobbling_stream_gremlin->has_next();
+        settle();
+        return !_has_current;
+    }
+
+    /// <summary>
+    /// Copy tokens until out is full or the scanner's block ends; reading the next block waits for the next call.
+    /// </summary>
+    std::size_t next_batch(std::span<T> out) override {
+        settle();
+        std::size_t count = 0;
+        while (count < out.size() && _has_current) {
+            out[count++] = T(_current);
+            if (!_gobbling_stream_gremlin->next_buffered(_current)) {
+                _advance_pending = true;
+                break;
+            }
+        }
+        return count;
     }
 
     /// <summary>
     /// Close reader and return a writer for the same file.
     /// </summary>
     std::unique_ptr<IMergeWriter<T>> into_writer() override {
-        _sacred_file_portal->close();
-        _gobbling_stream_gremlin.reset();
-        _sacred_file_portal.reset();
+        _gobbling_stream_gremlin.reset(); // closes the file
+        _has_current = false;
+        _advance_pending = false;
         return std::make_unique<FileMergeWriter<T>>(_filename);
     }
+
+private:
+    void load_next() {
+        _has_current = _gobbling_stream_gremlin->next(_current);
+    }
+
+    void settle() {
+        if (_advance_pending) {
+            _advance_pending = false;
+            load_next();
+        }
+    }
 };
 
 /// <summary>
@@ -2,8 +2,11 @@
 
 #include "merge_sort.hpp"
 
+#include <algorithm>
+#include <iterator>
 #include <vector>
 #include <memory>
+#include <span>
 #include <stdexcept>
 
 // Forward declarations to resolve circular dependency
@@ -11,8 +14,13 @@ template<typename T> class InMemoryReader;
 template<typename T> class InMemoryWriter;
 
 
+/// <summary>
+/// Reader over a shared vector. The class is final and offers direct access to the unread
+/// elements, so merge_sorter merges in-memory buffers without a virtual call per element
+/// and moves the elements instead of copying them.
+/// </summary>
 template<typename T>
-class InMemoryReader : public IMergeReader<T> {
+class InMemoryReader final : public IMergeReader<T> {
 private:
     std::shared_ptr<std::vector<T>> _enchanted_data_bag;
     size_t _sneaky_cursor;
@@ -41,6 +49,45 @@ public:
         return _sneaky_cursor >= _enchanted_data_bag->size();
     }
 
+    size_t next_batch(std::span<T> out) override {
+        std::span<T> const batch = remaining().first(std::min(out.size(), remaining().size()));
+        std::copy(batch.begin(), batch.end(), out.begin());
+        skip(batch.size());
+        return batch.size();
+    }
+
+    /// <summary>
+    /// The unread elements, starting with the current one. Every element is read only once,
+    /// so callers may move elements out before they skip() past them.
+    /// </summary>
+    std::span<T> remaining() {
+        return std::span<T>(*_enchanted_data_bag).subspan(std::min(_sneaky_cursor, _enchanted_data_bag->size()));
+    }
+
+    /// <summary>
+    /// Take the unread elements, without copying or moving any of them if nothing was read yet.
+    /// The reader is exhausted afterwards.
+    /// </summary>
+    std::vector<T> release() {
+        std::vector<T> elements;
+        if (_sneaky_cursor == 0) {
+            elements.swap(*_enchanted_data_bag);
+        } else {
+            std::span<T> const unread = remaining();
+            elements.assign(std::make_move_iterator(unread.begin()), std::make_move_iterator(unread.end()));
+            _enchanted_data_bag->clear();
+        }
+        _sneaky_cursor = 0;
+        return elements;
+    }
+
+    /// <summary>
+    /// Advance past n elements at once.
+    /// </summary>
+    void skip(size_t n) {
+        _sneaky_cursor += n;
+    }
+
     std::unique_ptr<IMergeWriter<T>> into_writer() override {
         _enchanted_data_bag->clear();
         return std::make_unique<InMemoryWriter<T>>(_enchanted_data_bag);
@@ -48,7 +95,7 @@ public:
 };
 
 template<typename T>
-class InMemoryWriter : public IMergeWriter<T> {
+class InMemoryWriter final : public IMergeWriter<T> {
 private:
     std::shared_ptr<std::vector<T>> _enchanted_data_bag;
 
@@ -61,6 +108,18 @@ public:
         return true;
     }
 
+    bool append_batch(std::span<const T> values) override {
+        _enchanted_data_bag->insert(_enchanted_data_bag->end(), values.begin(), values.end());
+        return true;
+    }
+
+    /// <summary>
+    /// The written elements, for appending without a virtual call.
+    /// </summary>
+    std::vector<T>& data() {
+        return *_enchanted_data_bag;
+    }
+
     std::unique_ptr<IMergeReader<T>> into_reader() override {
         return std::make_unique<InMemoryReader<T>>(_enchanted_data_bag, 0);
     }
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "merge_sort.hpp"
+#include "file_manipulator.h"
+#include "mapped_file.h"
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Declare beforehand
+template<typename T> class LineMergeReader;
+template<typename T> class LineMergeWriter;
+
+/// <summary>
+/// IMergeReader implementation for line-oriented text files (CSV/TSV records), one element per line.
+/// The file is memory mapped: with T = std::string_view, get() returns a view of the line inside
+/// the mapping, valid until the reader is converted into a writer or destroyed.
+/// Line ends ("\n" or "\r\n") are not part of the record; a final line without one still counts.
+/// </summary>
+template<typename T>
+class LineMergeReader : public IMergeReader<T> {
+    static_assert(std::is_constructible_v<T, std::string_view>, "LineMergeReader: T must be constructible from std::string_view");
+
+private:
+    std::string _filename;
+    std::unique_ptr<mapped_file> _treasure_map;
+    std::string_view _unread; // everything behind the current line
+    std::string_view _current;
+    bool _has_current = false;
+
+public:
+    /// <summary>
+    /// Map a text file for reading lines; throws if the file cannot be opened.
+    /// </summary>
+    /// <param name="filename">Path to input file.</param>
+    explicit LineMergeReader(const std::string& filename)
+        : _filename(filename) {
+        _treasure_map = std::make_unique<mapped_file>(filename);
+        _unread = _treasure_map->view();
+        load_next();
+    }
+
+    /// <summary>
+    /// Return current line without consuming; throws on exhaustion.
+    /// </summary>
+    T get() override {
+        if (is_exhausted()) {
+            throw std::underflow_error("No more elements to read");
+        }
+        return T(_current);
+    }
+
+    /// <summary>
+    /// Consume current line and advance; returns whether another line is available.
+    /// </summary>
+    bool advance() override {
+        if (is_exhausted()) {
+            return false;
+        }
+        load_next();
+        return _has_current;
+    }
+
+    /// <summary>
+    /// True if no further lines are available.
+    /// </summary>
+    bool is_exhausted() override {
+        return !_has_current;
+    }
+
+    /// <summary>
+    /// Unmap the file and return a writer for the same file.
+    /// </summary>
+    std::unique_ptr<IMergeWriter<T>> into_writer() override {
+        _has_current = false;
+        _current = {};
+        _unread = {};
+        _treasure_map.reset(); // a mapped file cannot be truncated on every platform
+        return std::make_unique<LineMergeWriter<T>>(_filename);
+    }
+
+private:
+    void load_next() {
+        _has_current = !_unread.empty();
+        if (!_has_current) {
+            return;
+        }
+        auto const* end = static_cast<const char*>(std::memchr(_unread.data(), '\n', _unread.size()));
+        std::size_t const length = end == nullptr ? _unread.size() : static_cast<std::size_t>(end - _unread.data());
+        _current = _unread.substr(0, length);
+        _unread.remove_prefix(end == nullptr ? length : length + 1);
+        if (!_current.empty() && _current.back() == '\r') {
+            _current.remove_suffix(1);
+        }
+    }
+};
+
+/// <summary>
+/// IMergeWriter implementation for line-oriented text files; writes every element followed by "\n".
+/// </summary>
+template<typename T>
+class LineMergeWriter : public IMergeWriter<T> {
+private:
+    std::string _filename;
+    std::unique_ptr<std::ofstream> _sacred_file_portal;
+
+public:
+    /// <summary>
+    /// Create or truncate target file for writing lines; throws if file cannot be opened.
+    /// </summary>
+    /// <param name="filename">Path to output file.</param>
+    explicit LineMergeWriter(const std::string& filename)
+        : _filename(filename) {
+        // autotruncation by std::ofstream is not reliable
+        file_manipulator::delete_file(filename);
+        _sacred_file_portal = std::make_unique<std::ofstream>(filename, std::ios::binary);
+        if (!_sacred_file_portal->is_open()) {
+            throw std::runtime_error("LineMergeWriter: cannot open file for writing: " + filename);
+        }
+    }
+
+    /// <summary>
+    /// Append a line to the file; returns false if stream not open.
+    /// </summary>
+    bool append(const T& value) override {
+        if (!_sacred_file_portal->is_open()) {
+            return false;
+        }
+        std::string_view const line(value);
+        _sacred_file_portal->write(line.data(), static_cast<std::streamsize>(line.size()));
+        _sacred_file_portal->put('\n');
+        return true;
+    }
+
+    /// <summary>
+    /// Close writer and return a reader for the same file; throws if the lines could not be written.
+    /// </summary>
+    std::unique_ptr<IMergeReader<T>> into_reader() override {
+        _sacred_file_portal->close();
+        bool const written = !_sacred_file_portal->fail();
+        _sacred_file_portal.reset();
+        if (!written) {
+            throw std::runtime_error("LineMergeWriter: cannot write file: " + _filename);
+        }
+        return std::make_unique<LineMergeReader<T>>(_filename);
+    }
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Tournament tree of losers over k sorted sources, the selection structure of a k-way merge.
+/// Every inner node stores the source that lost the match played there, so replacing the
+/// winner only replays the matches on the path from its leaf to the root:
+/// one comparison per level, log2(k) per merged element.
+/// Ties are won by the source with the lower index, which keeps the merge stable.
+/// </summary>
+/// <typeparam name="T">Element type.</typeparam>
+/// <typeparam name="Compare">Strict weak ordering; the smallest element wins.</typeparam>
+template<typename T, typename Compare = std::less<>>
+class loser_tree {
+public:
+    using size_t = std::size_t;
+
+    /// <summary>
+    /// Create a tree for k sources, all of them exhausted until set() and build() are called.
+    /// </summary>
+    /// <param name="k">Number of sources; must be at least 1.</param>
+    /// <param name="cmp">Ordering of the elements.</param>
+    explicit loser_tree(size_t k, Compare cmp = {})
+        : _k(k), _losers(k, 0), _values(k), _exhausted(k, true), _cmp(std::move(cmp)) {
+        if (k == 0) {
+            throw std::invalid_argument("loser_tree: needs at least one source");
+        }
+    }
+
+    size_t size() const noexcept { return _k; }
+
+    /// <summary>
+    /// The ordering of the elements.
+    /// </summary>
+    const Compare& compare() const noexcept { return _cmp; }
+
+    /// <summary>
+    /// Set the current element of a source; takes effect with the next build().
+    /// </summary>
+    void set(size_t source, T value) {
+        _values[source] = std::move(value);
+        _exhausted[source] = false;
+    }
+
+    /// <summary>
+    /// Mark a source as exhausted; takes effect with the next build().
+    /// </summary>
+    void exhaust(size_t source) {
+        _exhausted[source] = true;
+    }
+
+    /// <summary>
+    /// Play all matches from scratch, in O(k).
+    /// </summary>
+    void build() {
+        _losers[0] = _k == 1 ? 0 : build_node(1);
+    }
+
+    /// <summary>
+    /// True if every source is exhausted.
+    /// </summary>
+    bool empty() const { return _exhausted[_losers[0]]; }
+
+    /// <summary>
+    /// Index of the source holding the smallest element.
+    /// </summary>
+    size_t top() const { return _losers[0]; }
+
+    /// <summary>
+    /// The smallest element of all sources.
+    /// </summary>
+    const T& top_value() const { return _values[_losers[0]]; }
+
+    /// <summary>
+    /// The winning source advanced: replace its element and replay its path in O(log k).
+    /// </summary>
+    void replace_top(T value) {
+        size_t const winner = _losers[0];
+        _values[winner] = std::move(value);
+        replay(winner);
+    }
+
+    /// <summary>
+    /// The winning source is exhausted: remove it and replay its path in O(log k).
+    /// </summary>
+    void pop_top() {
+        size_t const winner = _losers[0];
+        _exhausted[winner] = true;
+        replay(winner);
+    }
+
+private:
+    /// <summary>
+    /// True if source a wins the match against source b.
+    /// </summary>
+    bool beats(size_t a, size_t b) const {
+        if (_exhausted[a] || _exhausted[b]) {
+            return !_exhausted[a] || (_exhausted[b] && a < b);
+        }
+        // Ties go to the lower source, which keeps the merge stable with a single comparison
+        return a < b ? !std::invoke(_cmp, _values[b], _values[a]) : std::invoke(_cmp, _values[a], _values[b]);
+    }
+
+    /// <summary>
+    /// Inner nodes are 1 .. k-1, the leaf of source i is node k + i and the parent of node n is n / 2.
+    /// Returns the winner of the subtree and stores the loser in the node.
+    /// </summary>
+    size_t build_node(size_t node) {
+        if (node >= _k) {
+            return node - _k;
+        }
+        size_t const left = build_node(2 * node);
+        size_t const right = build_node(2 * node + 1);
+        if (beats(left, right)) {
+            _losers[node] = right;
+            return left;
+        }
+        _losers[node] = left;
+        return right;
+    }
+
+    void replay(size_t source) {
+        size_t winner = source;
+        for (size_t node = (source + _k) / 2; node > 0; node /= 2) {
+            if (beats(_losers[node], winner)) {
+                std::swap(_losers[node], winner);
+            }
+        }
+        _losers[0] = winner;
+    }
+
+    size_t _k;
+    std::vector<size_t> _losers; // _losers[0] holds the overall winner
+    std::vector<T> _values;
+    std::vector<bool> _exhausted;
+    Compare _cmp;
+};
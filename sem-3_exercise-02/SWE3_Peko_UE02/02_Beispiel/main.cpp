@@ -1,6 +1,138 @@
+#include "file_manipulator.h"
+#include "merge_sort.hpp"
 #include "random.h"
+#include "sort_verifier.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Check a sorted token file and, given an unsorted copy of the input, that no token was lost or duplicated.
+// Exit code 0 if the file verifies, 1 if not.
+int verify(std::string const& sorted_file, std::string const& input_file) {
+	sort_digest const output = sort_verifier::digest_tokens(sorted_file);
+	std::cout << sorted_file << ": " << output.count << " tokens, " << output.bytes << " bytes, multiset hash "
+	          << std::hex << std::setw(16) << std::setfill('0') << output.multiset_hash << std::dec << std::setfill(' ') << '\n';
+	bool ok = output.sorted();
+	if (ok) {
+		std::cout << "sorted\n";
+	} else {
+		std::cout << "NOT sorted: " << output.unsorted << " tokens smaller than their predecessor, the first at index "
+		          << output.first_unsorted << '\n';
+	}
+	if (!input_file.empty()) {
+		bool const same = output.same_elements(sort_verifier::digest_tokens(input_file));
+		std::cout << (same ? "same tokens as " : "NOT the same tokens as ") << input_file << '\n';
+		ok = ok && same;
+	}
+	return ok ? 0 : 1;
+}
+
+// Scaling of sort_file_on_disk with the number of threads.
+// Usage: 02_Beispiel [elements] [length]
+//        02_Beispiel verify <sorted file> [<unsorted copy of the input>]
+int main(int argc, char* argv[]) {
+	if (argc > 1 && std::string(argv[1]) == "verify") {
+		if (argc < 3) {
+			std::cerr << "usage: " << argv[0] << " verify <sorted file> [<unsorted copy of the input>]\n";
+			return 2;
+		}
+		try {
+			return verify(argv[2], argc > 3 ? argv[3] : "");
+		} catch (std::exception const& e) {
+			std::cerr << e.what() << '\n';
+			return 2;
+		}
+	}
+
+	std::size_t const elements = argc > 1 ? std::stoull(argv[1]) : 2000000;
+	std::size_t const length = argc > 2 ? std::stoull(argv[2]) : 10;
+	std::size_t const memory_budget = std::size_t{8} << 20; // small enough to need merge passes
+
+	std::string const source = "scaling_source.txt";
+	std::string const target = "scaling_target.txt";
+	file_manipulator::fill_randomly(source, elements, length);
+	double const megabytes = std::filesystem::file_size(source) / 1e6;
+	sort_digest const input = sort_verifier::digest_tokens(source);
+
+	std::vector<std::size_t> thread_counts;
+	std::size_t const hardware = std::max(1u, std::thread::hardware_concurrency());
+	for (std::size_t threads = 1; threads < hardware; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(hardware);
+
+	std::cout << elements << " strings of length " << length << " (" << std::fixed << std::setprecision(1) << megabytes << " MB), "
+	          << (memory_budget >> 20) << " MiB runs\n";
+	std::cout << "threads      seconds       MB/s    speedup\n";
+	double serial_seconds = 0;
+	for (std::size_t threads : thread_counts) {
+		std::filesystem::copy_file(source, target, std::filesystem::copy_options::overwrite_existing);
+		merge_sorter sorter(0, memory_budget, merge_sorter::default_io_queue_depth, threads);
+
+		auto const start = std::chrono::steady_clock::now();
+		sorter.sort_file_on_disk(target);
+		double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (!sort_verifier::digest_tokens(target).is_sorted_permutation_of(input)) {
+			std::cerr << "sorted output does not verify against the input\n";
+			return 1;
+		}
+		if (threads == 1) {
+			serial_seconds = seconds;
+		}
+
+		std::cout << std::setw(7) << threads << std::setw(13) << std::setprecision(3) << seconds
+		          << std::setw(11) << std::setprecision(1) << megabytes / seconds
+		          << std::setw(11) << std::setprecision(2) << serial_seconds / seconds << '\n';
+	}
+
+	// Raw against compressed run files, on the uniform corpus above and on a skewed one of repeated tokens.
+	// The scratch directory is kept to weigh the run files of the last two passes.
+	std::string const skewed = "scaling_skewed.txt";
+	file_manipulator::fill_options zipf;
+	zipf.dist = file_manipulator::distribution::zipf;
+	file_manipulator::fill_bulk(skewed, elements, length, zipf);
+	std::filesystem::path const scratch = "scaling_scratch";
+	std::cout << "\ncorpus        runs      seconds       MB/s  scratch MB\n";
+	for (std::string const& corpus : {source, skewed}) {
+		sort_digest const corpus_input = sort_verifier::digest_tokens(corpus);
+		for (bool compress : {false, true}) {
+			std::filesystem::copy_file(corpus, target, std::filesystem::copy_options::overwrite_existing);
+			std::filesystem::create_directory(scratch);
+			merge_sorter::options settings;
+			settings.memory_budget = memory_budget;
+			settings.temp_directory = scratch;
+			settings.cleanup = merge_sorter::cleanup_policy::never;
+			settings.compress_runs = compress;
+
+			auto const start = std::chrono::steady_clock::now();
+			merge_sorter(settings).sort_file_on_disk(target);
+			double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (!sort_verifier::digest_tokens(target).is_sorted_permutation_of(corpus_input)) {
+				std::cerr << "sorted output does not verify against the input\n";
+				return 1;
+			}
+			std::uintmax_t scratch_bytes = 0;
+			for (auto const& entry : std::filesystem::recursive_directory_iterator(scratch)) {
+				scratch_bytes += entry.is_regular_file() ? entry.file_size() : 0;
+			}
+			std::filesystem::remove_all(scratch);
+
+			std::cout << std::left << std::setw(9) << (corpus == source ? "uniform" : "zipf") << std::right << std::setw(9)
+			          << (compress ? "lz" : "raw") << std::setw(13) << std::setprecision(3) << seconds
+			          << std::setw(11) << std::setprecision(1) << std::filesystem::file_size(corpus) / 1e6 / seconds
+			          << std::setw(12) << scratch_bytes / 1e6 << '\n';
+		}
+	}
 
-int main() {
+	std::remove(skewed.c_str());
+	std::remove(source.c_str());
+	std::remove(target.c_str());
 	return 0;
 }
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// Read-only memory mapping of a whole file (mmap on POSIX, a file mapping view on Windows).
+/// The bytes stay valid as long as the object lives, so views into them can be handed out
+/// without copying. Empty files are represented by an empty view without a mapping.
+/// </summary>
+class mapped_file {
+public:
+    /// <summary>
+    /// Map the file; throws std::runtime_error if it cannot be opened or mapped.
+    /// </summary>
+    /// <param name="file_name">Path of the file to map.</param>
+    explicit mapped_file(const std::string& file_name) {
+#ifdef _WIN32
+        _file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (_file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("mapped_file: cannot open file: " + file_name);
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(_file, &size)) {
+            close();
+            throw std::runtime_error("mapped_file: cannot determine size of: " + file_name);
+        }
+        _size = static_cast<std::size_t>(size.QuadPart);
+        if (_size > 0) {
+            _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            _data = _mapping ? static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            if (_data == nullptr) {
+                close();
+                throw std::runtime_error("mapped_file: cannot map file: " + file_name);
+            }
+        }
+#else
+        _fd = ::open(file_name.c_str(), O_RDONLY);
+        if (_fd < 0) {
+            throw std::runtime_error("mapped_file: cannot open file: " + file_name);
+        }
+        struct stat info{};
+        if (::fstat(_fd, &info) != 0) {
+            close();
+            throw std::runtime_error("mapped_file: cannot determine size of: " + file_name);
+        }
+        _size = static_cast<std::size_t>(info.st_size);
+        if (_size > 0) {
+            void* address = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+            if (address == MAP_FAILED) {
+                close();
+                throw std::runtime_error("mapped_file: cannot map file: " + file_name);
+            }
+            _data = static_cast<const char*>(address);
+            // Runs are read front to back exactly once
+            ::madvise(address, _size, MADV_SEQUENTIAL);
+        }
+#endif
+    }
+
+    ~mapped_file() {
+        close();
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    const char* data() const noexcept { return _data; }
+
+    std::size_t size() const noexcept { return _size; }
+
+    std::string_view view() const noexcept { return std::string_view(_data, _size); }
+
+    /// <summary>
+    /// Ask the OS to start reading a byte range in the background, so later accesses do not fault.
+    /// Returns immediately; the range is clamped to the file and failures are ignored (it is only a hint).
+    /// </summary>
+    void prefetch(std::size_t offset, std::size_t length) const noexcept {
+        if (offset >= _size || length == 0) {
+            return;
+        }
+        length = std::min(length, _size - offset);
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+        WIN32_MEMORY_RANGE_ENTRY range{const_cast<char*>(_data + offset), length};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+        // madvise needs a page aligned start
+        std::size_t const page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        std::size_t const start = offset / page * page;
+        ::madvise(const_cast<char*>(_data + start), offset - start + length, MADV_WILLNEED);
+#endif
+    }
+
+private:
+    void close() noexcept {
+#ifdef _WIN32
+        if (_data != nullptr) {
+            UnmapViewOfFile(_data);
+        }
+        if (_mapping != nullptr) {
+            CloseHandle(_mapping);
+        }
+        if (_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(_file);
+        }
+        _mapping = nullptr;
+        _file = INVALID_HANDLE_VALUE;
+#else
+        if (_data != nullptr) {
+            ::munmap(const_cast<char*>(_data), _size);
+        }
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+        _fd = -1;
+#endif
+        _data = nullptr;
+    }
+
+    const char* _data = nullptr;
+    std::size_t _size = 0;
+#ifdef _WIN32
+    HANDLE _file = INVALID_HANDLE_VALUE;
+    HANDLE _mapping = nullptr;
+#else
+    int _fd = -1;
+#endif
+};
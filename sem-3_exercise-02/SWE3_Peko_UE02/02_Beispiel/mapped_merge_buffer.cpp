@@ -0,0 +1,274 @@
+#pragma once
+
+#include "merge_sort.hpp"
+#include "binary_merge_buffer.cpp"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/// <summary>
+/// IMergeReader implementation for binary run files (see run_format) on top of a memory mapping.
+/// With T = std::string_view, get() returns a view pointing directly into the mapped file,
+/// so merging compares and forwards records without allocating or copying.
+/// A view stays valid until the reader is converted into a writer or destroyed; for compressed run files
+/// (run_format::flag_compressed) views point into the decompressed block and only stay valid until the next advance(),
+/// next_batch() then stops at the end of the block and its views stay valid until the next call.
+/// Instead of a prefetch thread the OS is asked to read the next queue_depth blocks in the background.
+/// split_runs() hands out readers over single runs that share the mapping, for concurrent merging.
+/// Throws std::runtime_error on malformed files and on checksum mismatches.
+/// </summary>
+template<typename T>
+class MappedMergeReader : public IMergeReader<T> {
+    static_assert(std::is_constructible_v<T, std::string_view>, "MappedMergeReader: T must be constructible from std::string_view");
+
+private:
+    std::string _filename;
+    std::size_t _block_size;
+    std::size_t _queue_depth;
+    bool _checksums = false;
+    bool _compressed = false;
+    bool _durable;
+    std::shared_ptr<mapped_file> _treasure_map;
+    std::shared_ptr<std::vector<char>> _decoded; // payload of the current compressed block, shared with run readers
+    std::size_t _offset = 0;       // next block header in the mapping
+    std::size_t _cursor = 0;       // next record in the current payload (see payload())
+    std::size_t _cursor_end = 0;   // end of the current payload
+    std::uint32_t _records_left = 0;
+    std::string_view _current;
+    bool _has_current = false;
+    bool _advance_pending = false; // _current was handed out by next_batch(), the next record is not loaded yet
+    std::size_t _run_left = unlimited; // records left including the current one, for run readers
+
+    static constexpr std::size_t unlimited = std::numeric_limits<std::size_t>::max();
+
+public:
+    /// <summary>
+    /// Map a binary run file; throws if it cannot be mapped or has no valid header.
+    /// </summary>
+    /// <param name="filename">Path to the run file.</param>
+    /// <param name="block_size">Block size used when converting into a writer.</param>
+    /// <param name="queue_depth">Blocks prefetched ahead of the current one.</param>
+    /// <param name="durable">Make the writer returned by into_writer() durable.</param>
+    explicit MappedMergeReader(const std::string& filename, std::size_t block_size = run_format::default_block_size,
+                               std::size_t queue_depth = run_format::default_queue_depth, bool durable = false)
+        : _filename(filename), _block_size(block_size), _queue_depth(queue_depth), _durable(durable) {
+        _treasure_map = std::make_shared<mapped_file>(filename);
+        run_format::file_header header{};
+        if (_treasure_map->size() < sizeof(header)) {
+            throw std::runtime_error("MappedMergeReader: not a binary run file: " + filename);
+        }
+        std::memcpy(&header, _treasure_map->data(), sizeof(header));
+        if (header.magic != run_format::magic || header.version != run_format::version) {
+            throw std::runtime_error("MappedMergeReader: not a binary run file: " + filename);
+        }
+        _checksums = (header.flags & run_format::flag_checksums) != 0;
+        _compressed = (header.flags & run_format::flag_compressed) != 0;
+        _offset = sizeof(header);
+        load_next();
+    }
+
+    /// <summary>
+    /// Return current record without consuming; throws on exhaustion.
+    /// </summary>
+    T get() override {
+        if (is_exhausted()) {
+            throw std::underflow_error("No more elements to read");
+        }
+        return T(_current);
+    }
+
+    /// <summary>
+    /// Consume current record and advance; returns whether another record is available.
+    /// </summary>
+    bool advance() override {
+        if (is_exhausted()) {
+            return false;
+        }
+        step();
+        return _has_current;
+    }
+
+    /// <summary>
+    /// True if no further records are available.
+    /// </summary>
+    bool is_exhausted() override {
+        settle();
+        return !_has_current;
+    }
+
+    /// <summary>
+    /// Copy records until out is full; a compressed run also stops at the end of the decoded block,
+    /// decoding the next one waits for the next call.
+    /// </summary>
+    std::size_t next_batch(std::span<T> out) override {
+        settle();
+        std::size_t count = 0;
+        while (count < out.size() && _has_current) {
+            out[count++] = T(_current);
+            if (_compressed && _records_left == 0) {
+                _advance_pending = true;
+                break;
+            }
+            step();
+        }
+        return count;
+    }
+
+    /// <summary>
+    /// Unmap the file and return a writer truncating it.
+    /// </summary>
+    std::unique_ptr<IMergeWriter<T>> into_writer() override {
+        if (_run_left != unlimited) {
+            throw std::logic_error("MappedMergeReader: a run reader cannot be converted into a writer");
+        }
+        _treasure_map.reset();
+        _has_current = false;
+        _advance_pending = false;
+        _decoded.reset();
+        return std::make_unique<BinaryMergeWriter<T>>(_filename, _block_size, _checksums, _queue_depth, _compressed, _durable);
+    }
+
+    /// <summary>
+    /// Hand out one reader per run, each positioned on the first record of its run.
+    /// Whole blocks between run starts are skipped by their headers without reading their payload.
+    /// </summary>
+    std::vector<std::unique_ptr<IMergeReader<T>>> split_runs(const std::deque<std::size_t>& lengths) override {
+        settle();
+        std::vector<std::unique_ptr<IMergeReader<T>>> runs;
+        for (std::size_t length : lengths) {
+            auto run = std::make_unique<MappedMergeReader<T>>(*this);
+            run->_run_left = length;
+            run->_has_current = _has_current && length > 0;
+            runs.push_back(std::move(run));
+            skip(length);
+        }
+        _has_current = false;
+        return runs;
+    }
+
+private:
+    const char* bytes() const { return _treasure_map->data(); }
+
+    /// <summary>
+    /// Payload of the current block: in the mapping, or decompressed.
+    /// </summary>
+    const char* payload() const { return _compressed ? _decoded->data() : bytes(); }
+
+    /// <summary>
+    /// Consume the current record, ending a run reader at the end of its run.
+    /// </summary>
+    void step() {
+        if (_run_left != unlimited && --_run_left == 0) {
+            _has_current = false;
+            return;
+        }
+        load_next();
+    }
+
+    void settle() {
+        if (_advance_pending) {
+            _advance_pending = false;
+            step();
+        }
+    }
+
+    /// <summary>
+    /// Move the current position n records forward.
+    /// </summary>
+    void skip(std::size_t n) {
+        while (n > 0 && _has_current) {
+            if (n <= _records_left) {
+                load_next();
+                n--;
+                continue;
+            }
+            // The target lies beyond the current block: drop the rest of it and every following
+            // block that is skipped completely, then load the first record of the next block
+            n -= _records_left + 1;
+            _records_left = 0;
+            std::size_t const size = _treasure_map->size();
+            run_format::block_header header{};
+            while (n > 0 && size - _offset >= sizeof(header)) {
+                std::memcpy(&header, bytes() + _offset, sizeof(header));
+                if (header.record_count > n) {
+                    break;
+                }
+                if (size - _offset - sizeof(header) < header.payload_bytes) {
+                    throw std::runtime_error("MappedMergeReader: truncated block in " + _filename);
+                }
+                n -= header.record_count;
+                _offset += sizeof(header) + header.payload_bytes;
+            }
+            load_next();
+        }
+    }
+
+    void load_next() {
+        while (_records_left == 0) {
+            if (!enter_block()) {
+                _has_current = false;
+                return;
+            }
+        }
+        std::uint32_t length;
+        if (_cursor_end - _cursor < sizeof(length)) {
+            throw std::runtime_error("MappedMergeReader: truncated record in " + _filename);
+        }
+        std::memcpy(&length, payload() + _cursor, sizeof(length));
+        _cursor += sizeof(length);
+        if (_cursor_end - _cursor < length) {
+            throw std::runtime_error("MappedMergeReader: truncated record in " + _filename);
+        }
+        _current = std::string_view(payload() + _cursor, length);
+        _cursor += length;
+        _records_left--;
+        _has_current = true;
+    }
+
+    bool enter_block() {
+        std::size_t const size = _treasure_map->size();
+        if (_offset == size) {
+            return false; // clean end of file
+        }
+        run_format::block_header header{};
+        if (size - _offset < sizeof(header)) {
+            throw std::runtime_error("MappedMergeReader: truncated block in " + _filename);
+        }
+        std::memcpy(&header, bytes() + _offset, sizeof(header));
+        _offset += sizeof(header);
+        if (size - _offset < header.payload_bytes) {
+            throw std::runtime_error("MappedMergeReader: truncated block in " + _filename);
+        }
+        if (_checksums && run_format::crc32(bytes() + _offset, header.payload_bytes) != header.checksum) {
+            throw std::runtime_error("MappedMergeReader: checksum mismatch in " + _filename);
+        }
+        std::size_t const stored = _offset;
+        _offset += header.payload_bytes;
+        if (_compressed) {
+            // Run readers split off earlier may still read the previous block
+            if (!_decoded || _decoded.use_count() > 1) {
+                _decoded = std::make_shared<std::vector<char>>();
+            }
+            _decoded->clear();
+            if (!run_format::unpack(bytes() + stored, header.payload_bytes, *_decoded)) {
+                throw std::runtime_error("MappedMergeReader: corrupt compressed block in " + _filename);
+            }
+            _cursor = 0;
+            _cursor_end = _decoded->size();
+        } else {
+            _cursor = stored;
+            _cursor_end = _offset;
+        }
+        _records_left = header.record_count;
+        _treasure_map->prefetch(_offset, _queue_depth * (sizeof(header) + _block_size));
+        return true;
+    }
+};
@@ -1,191 +1,919 @@
 #include "merge_sort.hpp"
 #include "in_memory_merge_buffer.cpp"
 #include "file_merge_buffer.cpp"
-#include "stream_reader.h"
+#include "binary_merge_buffer.cpp"
+#include "mapped_merge_buffer.cpp"
+#include "line_merge_buffer.cpp"
+#include "record_order.h"
+#include "token_scanner.h"
+#include "thread_pool.hpp"
+#include "scratch_directory.h"
+#include "sort_manifest.h"
+#include "durable_file.h"
 
+#include <algorithm>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
 #include <memory>
+#include <optional>
+#include <sstream>
 #include <iostream>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
 
-/// Performs iterative external merge passes on two sorted input readers, writing
-/// chunk-wise alternately to two writers. The chunk size doubles after each pass
-/// until both halves are fully sorted. Reader/writer roles are swapped between
-/// passes to avoid additional buffers.
+#ifdef _WIN32
+#include <cstdio>
+#else
+#include <sys/resource.h>
+#endif
+
+/// Wait for every task before rethrowing the first error, so no task outlives the locals it works on.
+static void join_all(std::vector<std::future<void>> &tasks)
+{
+    for (auto &task : tasks)
+    {
+        task.wait();
+    }
+    for (auto &task : tasks)
+    {
+        task.get();
+    }
+}
+
+/// Elements moved per next_batch / append_batch call on the disk paths.
+static constexpr std::size_t batch_size = 256;
+
+/// Walks a reader one batch at a time: one virtual call per batch instead of three per element.
+/// A view from value() stays valid until exhausted() is called after the last pop() of its batch.
 template <typename T>
-void merge_sorter::sort(
-    std::unique_ptr<IMergeReader<T>> &reader_l,
-    std::unique_ptr<IMergeReader<T>> &reader_r,
-    std::unique_ptr<IMergeWriter<T>> &writer_l,
-    std::unique_ptr<IMergeWriter<T>> &writer_r,
-    size_t total_size)
-{
-    size_t chunk_size = 1;
+class batch_cursor
+{
+public:
+    explicit batch_cursor(IMergeReader<T> &reader)
+        : _reader(reader), _batch(batch_size)
+    {
+    }
+
+    /// True once the reader has no more elements; reads the next batch when the current one is used up.
+    bool exhausted()
+    {
+        if (_next == _count)
+        {
+            _count = _reader.next_batch(_batch);
+            _next = 0;
+        }
+        return _count == 0;
+    }
+
+    /// The current element; requires !exhausted().
+    T &value()
+    {
+        return _batch[_next];
+    }
+
+    void pop()
+    {
+        _next++;
+    }
+
+private:
+    IMergeReader<T> &_reader;
+    std::vector<T> _batch;
+    std::size_t _next = 0;
+    std::size_t _count = 0;
+};
+
+/// Bytes an element occupies while a run is sorted in memory.
+template <typename T>
+static std::size_t element_memory(const T &)
+{
+    return sizeof(T);
+}
+
+static std::size_t element_memory(const std::string &value)
+{
+    return sizeof(std::string) + value.size();
+}
+
+/// The writers as in-memory buffers, or an empty list if any of them is not one.
+template <typename T>
+static std::vector<InMemoryWriter<T> *> in_memory_writers(const std::vector<std::unique_ptr<IMergeWriter<T>>> &writers)
+{
+    std::vector<InMemoryWriter<T> *> memory_writers;
+    for (const auto &writer : writers)
+    {
+        auto *memory_writer = dynamic_cast<InMemoryWriter<T> *>(writer.get());
+        if (memory_writer == nullptr)
+        {
+            return {};
+        }
+        memory_writers.push_back(memory_writer);
+    }
+    return memory_writers;
+}
+
+/// Writer applying a merge_sorter::duplicate_policy to the sorted elements passing through it on their way
+/// to the target writer. Equal elements are folded into a pending one, which is written once a greater
+/// element arrives or finish() is called.
+template <typename T, typename Less>
+class reducing_writer final : public IMergeWriter<T>
+{
+public:
+    reducing_writer(IMergeWriter<T> &target, const Less &less, const merge_sorter::options &settings)
+        : _target(target), _less(less), _settings(settings)
+    {
+    }
+
+    bool append(const T &value) override
+    {
+        if (_has_pending && !_less(_pending, value))
+        {
+            if (_settings.duplicates == merge_sorter::duplicate_policy::combine)
+            {
+                _pending = _settings.reduce(_pending, value);
+            }
+            return true;
+        }
+        bool const written = flush();
+        _pending = value;
+        _has_pending = true;
+        return written;
+    }
+
+    bool append_batch(std::span<const T> values) override
+    {
+        bool written = true;
+        for (const T &value : values)
+        {
+            written = append(value) && written;
+        }
+        return written;
+    }
+
+    /// Write the pending element; returns the number of elements written to the target.
+    std::size_t finish()
+    {
+        flush();
+        return _written;
+    }
+
+    std::unique_ptr<IMergeReader<T>> into_reader() override
+    {
+        throw std::logic_error("reducing_writer: only forwards to another writer");
+    }
+
+private:
+    bool flush()
+    {
+        if (!_has_pending)
+        {
+            return true;
+        }
+        _has_pending = false;
+        _written++;
+        return _target.append(T(_pending));
+    }
+
+    IMergeWriter<T> &_target;
+    const Less &_less;
+    const merge_sorter::options &_settings;
+    owned_t<T> _pending{}; // views would dangle once the reader advances
+    bool _has_pending = false;
+    std::size_t _written = 0;
+};
+
+/// Sort a range of a run. Equal tokens are indistinguishable, so only other orderings pay for a stable sort.
+template <typename Iterator, typename Less>
+static void sort_run(Iterator first, Iterator last, const Less &less)
+{
+    if constexpr (std::is_same_v<Less, std::less<>>)
+    {
+        std::sort(first, last);
+    }
+    else
+    {
+        std::stable_sort(first, last, less);
+    }
+}
+
+merge_sorter::merge_sorter(size_t fan_in, size_t memory_budget, size_t io_queue_depth, size_t threads)
+    : merge_sorter([&]
+    {
+        options settings;
+        settings.fan_in = fan_in;
+        settings.memory_budget = memory_budget;
+        settings.io_queue_depth = io_queue_depth;
+        settings.threads = threads;
+        return settings;
+    }())
+{
+}
+
+merge_sorter::merge_sorter(options settings)
+    : _options(std::move(settings))
+{
+    if (_options.block_size == 0)
+    {
+        throw std::invalid_argument("merge_sorter: block size must not be 0");
+    }
+    if (_options.fan_in == 0)
+    {
+        _options.fan_in = default_fan_in(_options.memory_budget, _options.io_queue_depth, _options.block_size);
+    }
+    if (_options.fan_in < 2)
+    {
+        throw std::invalid_argument("merge_sorter: fan-in must be at least 2");
+    }
+    if (_options.duplicates == duplicate_policy::combine && !_options.reduce)
+    {
+        throw std::invalid_argument("merge_sorter: combining duplicates needs a reduce function");
+    }
+    if (_options.threads == 0)
+    {
+        _options.threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+}
+
+/// The open file limit is shared with the rest of the process, so a few descriptors
+/// are kept in reserve; a pass needs one descriptor per reader and per writer.
+/// Each of them buffers its current block plus io_queue_depth queued ones.
+merge_sorter::size_t merge_sorter::default_fan_in(size_t memory_budget, size_t io_queue_depth, size_t block_size)
+{
+    constexpr size_t reserved_files = 16;
+    size_t file_limit = 512;
+#ifdef _WIN32
+    file_limit = static_cast<size_t>(_getmaxstdio());
+#else
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+    {
+        file_limit = static_cast<size_t>(limit.rlim_cur);
+    }
+#endif
+    size_t const by_files = file_limit > reserved_files ? (file_limit - reserved_files) / 2 : 2;
+    size_t const by_memory = memory_budget / (2 * block_size * (1 + io_queue_depth));
+    return std::clamp<size_t>(std::min(by_files, by_memory), 2, max_fan_in);
+}
+
+/// Performs k-way merge passes on the sorted runs of the readers, writing every
+/// merged run to the next writer in turn. Each pass divides the number of runs
+/// by k; reader/writer roles are swapped between passes to avoid additional buffers.
+template <typename T, typename Less>
+void merge_sorter::sort(reader_list<T> &readers, writer_list<T> &writers, run_lengths &runs, thread_pool *pool, const Less &less,
+                        const std::function<void(const run_lengths &)> &pass_done)
+{
+    auto run_count = [&runs]
+    {
+        size_t count = 0;
+        for (const auto &lengths : runs)
+        {
+            count += lengths.size();
+        }
+        return count;
+    };
+
+    // Once every reader holds at most one run, the final merge into the source finishes the sort
+    while (run_count() > readers.size())
+    {
+        run_lengths merged(writers.size());
+        merge(readers, runs, writers, merged, pool, less);
+
+        // Prepare the next pass: the written runs are read, the consumed readers are rewritten.
+        // All new runs are closed before the first old one is truncated, so pass_done sees a complete pass.
+        reader_list<T> merged_readers;
+        for (auto &writer : writers)
+        {
+            merged_readers.push_back(writer->into_reader());
+        }
+        runs = std::move(merged);
+        if (pass_done)
+        {
+            pass_done(runs);
+        }
+        for (size_t i = 0; i < readers.size(); i++)
+        {
+            writers[i] = readers[i]->into_writer();
+        }
+        readers = std::move(merged_readers);
+    }
+}
+
+/// Merge the runs of the readers k at a time, appending the merged runs to
+/// the writers in turn. This distribution allows the next pass to read back
+/// k runs at once without extra copying.
+template <typename T, typename Less>
+void merge_sorter::merge(reader_list<T> &readers, run_lengths &runs_in, writer_list<T> &writers, run_lengths &runs_out, thread_pool *pool, const Less &less)
+{
+    if (pool != nullptr && pool->size() > 1 && merge_concurrently(readers, runs_in, writers, runs_out, *pool, less))
+    {
+        return;
+    }
+
+    loser_tree<T, Less> tree(readers.size(), less);
+    std::vector<size_t> lengths(readers.size());
+    size_t target = 0; // Start with the first writer, then cycle through all of them
+
     while (true)
     {
-        merge(*reader_l, *reader_r, *writer_l, *writer_r, chunk_size);
-        chunk_size *= 2;
-        // We have to divide by 2 
-        // because we are writing the result to two writers 
-        // so each writer only gets half
-        if (chunk_size > total_size / 2)
+        bool any_run = false;
+        for (size_t i = 0; i < readers.size(); i++)
+        {
+            lengths[i] = 0;
+            if (!runs_in[i].empty())
+            {
+                lengths[i] = runs_in[i].front();
+                runs_in[i].pop_front();
+                any_run = true;
+            }
+        }
+        if (!any_run)
         {
-            // We have finished the last iteration and writers contain finished sorted half data
             break;
         }
 
-        // Prepare next chunk sized merge run
-        auto tmp_writer_l = reader_l->into_writer();
-        auto tmp_writer_r = reader_r->into_writer();
+        runs_out[target].push_back(merge_step(readers, lengths, *writers[target], tree));
+        target = (target + 1) % writers.size();
+    }
+}
 
-        reader_l = writer_l->into_reader(); // re-seat: OK, we own the pointer
-        reader_r = writer_r->into_reader();
+/// The j-th merge reads the j-th run of every reader and writes to writer j % k, so the merges
+/// of one writer depend on each other only through the order of its runs. Once every run has a
+/// reader of its own, the k writers are filled concurrently.
+template <typename T, typename Less>
+bool merge_sorter::merge_concurrently(reader_list<T> &readers, run_lengths &runs_in, writer_list<T> &writers, run_lengths &runs_out, thread_pool &pool, const Less &less)
+{
+    std::vector<reader_list<T>> run_readers(readers.size()); // [reader][run]
+    size_t steps = 0;
+    for (size_t i = 0; i < readers.size(); i++)
+    {
+        steps = std::max(steps, runs_in[i].size());
+        if (runs_in[i].empty())
+        {
+            continue;
+        }
+        run_readers[i] = readers[i]->split_runs(runs_in[i]);
+        if (run_readers[i].empty())
+        {
+            // All readers of a pass are of the same kind, so only the first one with runs can fail
+            return false;
+        }
+    }
 
-        writer_l = std::move(tmp_writer_l);
-        writer_r = std::move(tmp_writer_r);
+    std::vector<std::future<void>> tasks;
+    for (size_t target = 0; target < writers.size(); target++)
+    {
+        tasks.push_back(pool.submit([&, target]
+        {
+            loser_tree<T, Less> tree(readers.size(), less);
+            reader_list<T> step_readers(readers.size());
+            std::vector<size_t> lengths(readers.size());
+            for (size_t step = target; step < steps; step += writers.size())
+            {
+                for (size_t i = 0; i < readers.size(); i++)
+                {
+                    // Readers without a j-th run get length 0 and are never touched by merge_step
+                    bool const has_run = step < runs_in[i].size();
+                    lengths[i] = has_run ? runs_in[i][step] : 0;
+                    step_readers[i] = has_run ? std::move(run_readers[i][step]) : nullptr;
+                }
+                runs_out[target].push_back(merge_step(step_readers, lengths, *writers[target], tree));
+            }
+        }));
     }
+    join_all(tasks); // rethrows errors of the merges
+
+    for (auto &lengths : runs_in)
+    {
+        lengths.clear();
+    }
+    return true;
 }
 
-/// Merge two already-sorted readers chunk-wise, appending the merged runs to
-/// alternating writers. This alternation allows the next pass to read back
-/// the merged runs without extra copying.
-template <typename T>
-void merge_sorter::merge(IMergeReader<T> &sorted_l, IMergeReader<T> &sorted_r, IMergeWriter<T> &writer_l, IMergeWriter<T> &writer_r, size_t chunk_size)
+/// Split a source reader into the destination writers by writing one element
+/// to each writer in turn. Returns the run lengths, every element being a run.
+template <typename T, typename Less>
+merge_sorter::run_lengths merge_sorter::split(IMergeReader<T> &reader, writer_list<T> &writers, const Less &less)
 {
-    bool write_to_left = true; // Start with writer_l for first chunk (we're fair, not biased)
+    if (_options.natural_runs)
+    {
+        return split_natural(reader, writers, less);
+    }
 
-    while (true)
+    run_lengths runs(writers.size());
+    size_t target = 0;
+
+    // In-memory buffers take the elements by move
+    auto *memory_reader = dynamic_cast<InMemoryReader<T> *>(&reader);
+    std::vector<InMemoryWriter<T> *> const memory_writers = in_memory_writers(writers);
+    if (memory_reader != nullptr && !memory_writers.empty())
+    {
+        std::span<T> const elements = memory_reader->remaining();
+        for (T &element : elements)
+        {
+            memory_writers[target]->data().push_back(std::move(element));
+            runs[target].push_back(1);
+            target = (target + 1) % writers.size();
+        }
+        memory_reader->skip(elements.size());
+        return runs;
+    }
+
+    batch_cursor<T> input(reader);
+    while (!input.exhausted())
     {
-        IMergeWriter<T> &writer = write_to_left ? writer_l : writer_r;
+        writers[target]->append(input.value());
+        input.pop(); // Advance reader to next element
+        runs[target].push_back(1);
+
+        target = (target + 1) % writers.size();
+    }
+    return runs;
+}
 
-        if (!merge_step(sorted_l, sorted_r, writer, chunk_size))
+/// In memory a run is found by looking ahead in the reader's vector. A strictly descending run is
+/// reversed in place (strictness keeps equal elements in input order), a run shorter than natural_min_run
+/// is extended by binary insertion; then the run is moved to its writer. Other readers are compared
+/// against a copy of the previous element, a smaller element starts the next run.
+template <typename T, typename Less>
+merge_sorter::run_lengths merge_sorter::split_natural(IMergeReader<T> &reader, writer_list<T> &writers, const Less &less)
+{
+    run_lengths runs(writers.size());
+    size_t target = 0;
+
+    auto *memory_reader = dynamic_cast<InMemoryReader<T> *>(&reader);
+    std::vector<InMemoryWriter<T> *> const memory_writers = in_memory_writers(writers);
+    if (memory_reader != nullptr && !memory_writers.empty())
+    {
+        std::span<T> const elements = memory_reader->remaining();
+        auto const at = [&elements](size_t index) { return elements.begin() + index; };
+        size_t begin = 0;
+        while (begin < elements.size())
         {
-            break;
+            size_t end = begin + 1;
+            if (end < elements.size() && less(elements[end], elements[begin]))
+            {
+                while (end < elements.size() && less(elements[end], elements[end - 1]))
+                {
+                    end++;
+                }
+                std::reverse(at(begin), at(end));
+            }
+            else
+            {
+                while (end < elements.size() && !less(elements[end], elements[end - 1]))
+                {
+                    end++;
+                }
+            }
+
+            // upper_bound inserts behind equal elements, which keeps the insertion stable
+            for (size_t const min_end = std::min(begin + natural_min_run, elements.size()); end < min_end; end++)
+            {
+                std::rotate(std::upper_bound(at(begin), at(end), elements[end], less), at(end), at(end + 1));
+            }
+
+            std::vector<T> &out = memory_writers[target]->data();
+            out.insert(out.end(), std::make_move_iterator(at(begin)), std::make_move_iterator(at(end)));
+            runs[target].push_back(end - begin);
+            target = (target + 1) % writers.size();
+            begin = end;
+        }
+        memory_reader->skip(elements.size());
+        return runs;
+    }
+
+    owned_t<T> last{}; // views would dangle once the reader advances
+    size_t length = 0;
+    batch_cursor<T> input(reader);
+    while (!input.exhausted())
+    {
+        T const &value = input.value();
+        if (length > 0 && less(value, last))
+        {
+            runs[target].push_back(length);
+            target = (target + 1) % writers.size();
+            length = 0;
+        }
+        writers[target]->append(value);
+        last = value;
+        length++;
+        input.pop();
+    }
+    if (length > 0)
+    {
+        runs[target].push_back(length);
+    }
+    return runs;
+}
+
+/// Cut the source into runs of about run_memory bytes, each sorted in memory
+/// and written to the next writer in turn. Returns the run lengths.
+template <typename T, typename Less>
+merge_sorter::run_lengths merge_sorter::form_runs(IMergeReader<T> &reader, writer_list<T> &writers, size_t run_memory, thread_pool *pool, const Less &less)
+{
+    run_lengths runs(writers.size());
+    std::vector<owned_t<T>> run; // views would dangle once the reader advances
+    size_t target = 0;
+    batch_cursor<T> input(reader);
+    while (!input.exhausted())
+    {
+        // Fill the budget; a single oversized element still forms a run
+        size_t used = 0;
+        while ((run.empty() || used < run_memory) && !input.exhausted())
+        {
+            run.push_back(owned_t<T>(std::move(input.value())));
+            used += element_memory(run.back());
+            input.pop();
+        }
+
+        // Duplicates are reduced on the way into the writer, which leaves shorter runs
+        std::optional<reducing_writer<T, Less>> reducer;
+        IMergeWriter<T> *out = writers[target].get();
+        if (_options.duplicates != duplicate_policy::keep)
+        {
+            out = &reducer.emplace(*out, less, _options);
+        }
+
+        size_t length = run.size();
+        if (!_options.natural_runs)
+        {
+            write_sorted_run(run, *out, pool, less);
         }
+        else
+        {
+            // Sorted and reversed chunks only need to be written in the right direction
+            if (std::is_sorted(run.begin(), run.end(), less))
+            {
+                for (const auto &value : run)
+                {
+                    out->append(T(value));
+                }
+            }
+            else if (std::adjacent_find(run.begin(), run.end(), [&less](const auto &a, const auto &b) { return !less(b, a); }) == run.end())
+            {
+                std::for_each(run.rbegin(), run.rend(), [&](const auto &value) { out->append(T(value)); });
+            }
+            else
+            {
+                write_sorted_run(run, *out, pool, less);
+            }
 
-        // Switch to the other writer for the next chunk
-        write_to_left = !write_to_left;
+            // Elements not below the largest one written continue the run without taking any memory,
+            // so a sorted input becomes a single run however large it is
+            owned_t<T> last = std::move(*std::max_element(run.begin(), run.end(), less));
+            while (!input.exhausted())
+            {
+                T const &value = input.value();
+                if (less(value, last))
+                {
+                    break;
+                }
+                out->append(value);
+                last = value;
+                length++;
+                input.pop();
+            }
+        }
+        runs[target].push_back(reducer ? reducer->finish() : length);
+        run.clear();
+
+        target = (target + 1) % writers.size();
     }
+    return runs;
 }
 
-/// Split a source reader into two destination writers by alternately writing
-/// elements to left and right writers. Returns the number of elements observed.
-template <typename T>
-long long merge_sorter::split(IMergeReader<T> &reader, IMergeWriter<T> &writer_l, IMergeWriter<T> &writer_r)
+/// Pieces smaller than min_piece elements are not worth a task of their own.
+template <typename T, typename Less>
+void merge_sorter::write_sorted_run(std::vector<owned_t<T>> &run, IMergeWriter<T> &writer, thread_pool *pool, const Less &less)
 {
-    long long count = 0;
-    while (!reader.is_exhausted())
+    constexpr size_t min_piece = 4096;
+    size_t const pieces = pool == nullptr ? 1 : std::min(pool->size(), run.size() / min_piece);
+    if (pieces <= 1)
     {
-        auto value = reader.get();
-        reader.advance(); // Advance reader to next element
+        sort_run(run.begin(), run.end(), less);
+        for (const auto &value : run)
+        {
+            writer.append(T(value));
+        }
+        return;
+    }
 
-        if (count % 2 == 0) // We can use the counter to alternate between writers
+    // Sort the pieces concurrently
+    std::vector<size_t> bounds(pieces + 1);
+    for (size_t p = 0; p <= pieces; p++)
+    {
+        bounds[p] = run.size() * p / pieces;
+    }
+    std::vector<std::future<void>> tasks;
+    for (size_t p = 0; p < pieces; p++)
+    {
+        tasks.push_back(pool->submit([&run, &bounds, &less, p]
         {
-            writer_l.append(value);
+            sort_run(run.begin() + bounds[p], run.begin() + bounds[p + 1], less);
+        }));
+    }
+    join_all(tasks);
+
+    // Merge the sorted pieces straight into the writer
+    std::vector<size_t> next(bounds.begin(), bounds.end() - 1);
+    loser_tree<T, Less> tree(pieces, less);
+    for (size_t p = 0; p < pieces; p++)
+    {
+        tree.set(p, T(run[next[p]]));
+    }
+    tree.build();
+    while (!tree.empty())
+    {
+        size_t const source = tree.top();
+        writer.append(tree.top_value());
+        if (++next[source] < bounds[source + 1])
+        {
+            tree.replace_top(T(run[next[source]]));
         }
         else
         {
-            writer_r.append(value);
+            tree.pop_top();
         }
-        // Increment the element counter
-        count-=-1;
     }
-    return count;
 }
 
-/// Merge a single run from each reader into a target writer. Each side contributes
-/// up to chunk_size_per_reader elements (or until exhausted). Returns true if any
-/// reader still has elements remaining; false if both are exhausted for this pass.
-template <typename T>
-bool merge_sorter::merge_step(IMergeReader<T> &reader_l, IMergeReader<T> &reader_r, IMergeWriter<T> &writer, size_t chunk_size_per_reader)
+/// Merge a single run from each reader into a target writer. Reader i contributes
+/// lengths[i] elements (or until exhausted); the loser tree always yields the
+/// smallest current element in log2(k) comparisons. Returns the merged run length.
+/// All buffers of a sort are of the same kind, so in-memory buffers are detected once per step
+/// and merged by merge_step_in_memory without any virtual call per element. Other buffers are read
+/// (and views written) in batches; a reader's batch stays valid until its next call, so the views
+/// collected for the writer are handed over before any reader is asked for its next batch.
+template <typename T, typename Less>
+merge_sorter::size_t merge_sorter::merge_step(reader_list<T> &readers, const std::vector<size_t> &lengths, IMergeWriter<T> &writer, loser_tree<T, Less> &tree)
 {
-    size_t l_merged_count = 0; // Increment until chunk_size is reached
-    size_t r_merged_count = 0; // Increment until chunk_size is reached
-    bool l_exhausted = reader_l.is_exhausted();
-    bool r_exhausted = reader_r.is_exhausted();
+    // Views are never kept in in-memory buffers, they would dangle
+    if constexpr (std::is_same_v<T, owned_t<T>>)
+    {
+        if (auto *memory_writer = dynamic_cast<InMemoryWriter<T> *>(&writer))
+        {
+            std::vector<InMemoryReader<T> *> memory_readers(readers.size(), nullptr);
+            bool all_in_memory = true;
+            for (size_t i = 0; i < readers.size() && all_in_memory; i++)
+            {
+                memory_readers[i] = dynamic_cast<InMemoryReader<T> *>(readers[i].get());
+                all_in_memory = memory_readers[i] != nullptr || readers[i] == nullptr;
+            }
+            if (all_in_memory)
+            {
+                return merge_step_in_memory(memory_readers, lengths, *memory_writer, tree.compare());
+            }
+        }
+    }
 
-    // Zip and merge one chunk of size chunk_size_per_reader
-    while (l_merged_count < chunk_size_per_reader && r_merged_count < chunk_size_per_reader && !l_exhausted && !r_exhausted)
+    std::optional<reducing_writer<T, Less>> reducer;
+    IMergeWriter<T> *out = &writer;
+    if (_options.duplicates != duplicate_policy::keep)
     {
-        T left_val = reader_l.get();
-        T right_val = reader_r.get();
+        out = &reducer.emplace(writer, tree.compare(), _options);
+    }
+
+    // Batches of width elements per reader, followed by the views waiting for the writer
+    constexpr bool views = !std::is_same_v<T, owned_t<T>>;
+    size_t const width = std::min(batch_size, *std::max_element(lengths.begin(), lengths.end()));
+    std::vector<T> slots((readers.size() + 1) * width);
+    T *const waiting = slots.data() + readers.size() * width;
+    size_t waiting_count = 0;
+    auto hand_over = [&]
+    {
+        out->append_batch(std::span<const T>(waiting, waiting_count));
+        waiting_count = 0;
+    };
+
+    std::vector<size_t> remaining(lengths);
+    std::vector<size_t> next(readers.size(), 0);
+    std::vector<size_t> filled(readers.size(), 0);
+    auto refill = [&](size_t i)
+    {
+        if (views && waiting_count > 0)
+        {
+            hand_over(); // the waiting views may point into this reader's batch
+        }
+        size_t const wanted = std::min(width, remaining[i]);
+        filled[i] = wanted == 0 ? 0 : readers[i]->next_batch(std::span<T>(slots.data() + i * width, wanted));
+        remaining[i] -= filled[i];
+        next[i] = 0;
+        return filled[i] > 0;
+    };
+
+    for (size_t i = 0; i < readers.size(); i++)
+    {
+        if (refill(i))
+        {
+            tree.set(i, std::move(slots[i * width + next[i]++]));
+        }
+        else
+        {
+            tree.exhaust(i);
+        }
+    }
+    tree.build();
+
+    size_t merged_count = 0;
+    while (!tree.empty())
+    {
+        size_t const source = tree.top();
+        if constexpr (views)
+        {
+            waiting[waiting_count++] = tree.top_value();
+            if (waiting_count == width)
+            {
+                hand_over();
+            }
+        }
+        else
+        {
+            out->append(tree.top_value());
+        }
+        merged_count-=-1;
 
-        if (left_val <= right_val)
+        // Refill the winning leaf from its reader's batch unless its run is finished
+        if (next[source] < filled[source] || refill(source))
         {
-            writer.append(left_val);
-            l_exhausted = !reader_l.advance();
-            l_merged_count-=-1;
+            tree.replace_top(std::move(slots[source * width + next[source]++]));
         }
         else
         {
-            writer.append(right_val);
-            r_exhausted = !reader_r.advance();
-            r_merged_count-=-1;
+            tree.pop_top();
         }
     }
+    if (views && waiting_count > 0)
+    {
+        hand_over();
+    }
+    return reducer ? reducer->finish() : merged_count;
+}
 
-    // Finish remaining elements from left reader for this chunk
-    while (l_merged_count < chunk_size_per_reader && !l_exhausted)
+/// The runs are contiguous ranges of the readers' vectors: a single run is moved in one go,
+/// two runs go through std::merge and more runs through a loser tree over element pointers.
+/// Elements are moved into the writer, never copied. Ties prefer the lower reader, like merge_step.
+template <typename T, typename Less>
+merge_sorter::size_t merge_sorter::merge_step_in_memory(const std::vector<InMemoryReader<T> *> &readers, const std::vector<size_t> &lengths, InMemoryWriter<T> &writer, const Less &less)
+{
+    struct pointee_less
     {
-        writer.append(reader_l.get());
-        l_exhausted = !reader_l.advance();
-        l_merged_count-=-1;
+        const Less *less;
+        bool operator()(const T *a, const T *b) const { return (*less)(*a, *b); }
+    };
+
+    std::vector<std::span<T>> runs;
+    size_t merged_count = 0;
+    for (size_t i = 0; i < readers.size(); i++)
+    {
+        if (readers[i] == nullptr || lengths[i] == 0)
+        {
+            continue;
+        }
+        std::span<T> const unread = readers[i]->remaining();
+        size_t const length = std::min(lengths[i], unread.size());
+        if (length > 0)
+        {
+            runs.push_back(unread.first(length));
+            readers[i]->skip(length);
+            merged_count += length;
+        }
     }
 
-    // Finish remaining elements from right reader for this chunk
-    while (r_merged_count < chunk_size_per_reader && !r_exhausted)
+    // No reserve(): growing by exactly one run per step would reallocate on every step
+    std::vector<T> &out = writer.data();
+    size_t const first = out.size();
+    if (runs.size() == 1)
+    {
+        out.insert(out.end(), std::make_move_iterator(runs[0].begin()), std::make_move_iterator(runs[0].end()));
+    }
+    else if (runs.size() == 2)
     {
-        writer.append(reader_r.get());
-        r_exhausted = !reader_r.advance();
-        r_merged_count-=-1;
+        // Like TimSort's galloping, binary searches cut off what needs no merging: the head of the
+        // first run up to the front of the second and the tail of the second beyond the back of the first
+        auto const head_end = std::upper_bound(runs[0].begin(), runs[0].end(), runs[1].front(), less);
+        auto const tail_begin = std::lower_bound(runs[1].begin(), runs[1].end(), runs[0].back(), less);
+        out.insert(out.end(), std::make_move_iterator(runs[0].begin()), std::make_move_iterator(head_end));
+        std::merge(std::make_move_iterator(head_end), std::make_move_iterator(runs[0].end()),
+                   std::make_move_iterator(runs[1].begin()), std::make_move_iterator(tail_begin), std::back_inserter(out), less);
+        out.insert(out.end(), std::make_move_iterator(tail_begin), std::make_move_iterator(runs[1].end()));
+    }
+    else if (runs.size() > 2)
+    {
+        std::vector<size_t> next(runs.size(), 0);
+        loser_tree<const T *, pointee_less> tree(runs.size(), pointee_less{&less});
+        for (size_t r = 0; r < runs.size(); r++)
+        {
+            tree.set(r, &runs[r][0]);
+        }
+        tree.build();
+        while (!tree.empty())
+        {
+            // The moved-from element leaves the tree right away, it is never compared again
+            size_t const source = tree.top();
+            out.push_back(std::move(runs[source][next[source]]));
+            if (++next[source] < runs[source].size())
+            {
+                tree.replace_top(&runs[source][next[source]]);
+            }
+            else
+            {
+                tree.pop_top();
+            }
+        }
     }
+    return _options.duplicates == duplicate_policy::keep ? merged_count : collapse_duplicates(out, first, less);
+}
 
-    return !l_exhausted || !r_exhausted;
+/// Compacts in place: every element either moves down behind the last kept one or is folded into it.
+template <typename T, typename Less>
+merge_sorter::size_t merge_sorter::collapse_duplicates(std::vector<T> &values, size_t first, const Less &less)
+{
+    size_t kept = first;
+    for (size_t next = first; next < values.size(); next++)
+    {
+        if (kept > first && !less(values[kept - 1], values[next]))
+        {
+            if (_options.duplicates == duplicate_policy::combine)
+            {
+                values[kept - 1] = _options.reduce(values[kept - 1], values[next]);
+            }
+            continue;
+        }
+        if (kept != next)
+        {
+            values[kept] = std::move(values[next]);
+        }
+        kept++;
+    }
+    values.resize(kept);
+    return kept - first;
 }
 
-/// Orchestrates a complete sort using four buffers: two for producing merged runs
-/// and two for reading them in the next pass. After final pass, merges both halves
-/// into the original source and re-seats the source reader at position 0.
-template <typename T>
-void merge_sorter::complete_sort(
-    std::unique_ptr<IMergeReader<T>> &unsorted_source,
-    std::unique_ptr<IMergeWriter<T>> buffer1,
-    std::unique_ptr<IMergeWriter<T>> buffer2,
-    std::unique_ptr<IMergeWriter<T>> buffer3,
-    std::unique_ptr<IMergeWriter<T>> buffer4)
-{
-    // Split the unsorted source into two halves
-    auto total_size = split(*unsorted_source, *buffer1, *buffer2);
-
-    // Sort the two halves
-    auto reader_l = buffer1->into_reader();
-    auto reader_r = buffer2->into_reader();
-    sort<T>(reader_l, reader_r, buffer3, buffer4, total_size);
-
-    // Merge the two sorted halves into the soure
-    auto sorted_l = buffer3->into_reader();
-    auto sorted_r = buffer4->into_reader();
+/// Orchestrates a complete sort using 2k buffers: k for producing merged runs
+/// and k for reading them in the next pass. After the final pass, merges the
+/// last k runs into the original source and re-seats the source reader at position 0.
+template <typename T, typename Less>
+void merge_sorter::complete_sort(std::unique_ptr<IMergeReader<T>> &unsorted_source, writer_list<T> buffers, size_t run_memory, thread_pool *pool, const Less &less)
+{
+    size_t const k = buffers.size() / 2;
+    writer_list<T> writers;
+    writer_list<T> spare;
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        (i < k ? writers : spare).push_back(std::move(buffers[i]));
+    }
+
+    // Distribute the unsorted source to k buffers, as sorted runs if memory is granted
+    run_lengths runs = run_memory > 0 ? form_runs(*unsorted_source, writers, run_memory, pool, less) : split(*unsorted_source, writers, less);
+
+    // Merge until at most k runs are left
+    reader_list<T> readers;
+    for (auto &writer : writers)
+    {
+        readers.push_back(writer->into_reader());
+    }
+    sort<T>(readers, spare, runs, pool, less);
+
+    // Merge the remaining runs into the source
     auto sorted_full = unsorted_source->into_writer();
-    merge_step<T>(*sorted_l, *sorted_r, *sorted_full, total_size);
+    merge_final(readers, runs, *sorted_full, less);
 
     // re-seat the source => reset the cursor to 0
     unsorted_source = sorted_full->into_reader();
 }
 
-/// @brief Sorts the file in memory using the merge sort algorithm with four in memory buffers.
+template <typename T, typename Less>
+void merge_sorter::merge_final(reader_list<T> &readers, const run_lengths &runs, IMergeWriter<T> &writer, const Less &less)
+{
+    std::vector<size_t> lengths(readers.size(), 0);
+    for (size_t i = 0; i < readers.size(); i++)
+    {
+        if (!runs[i].empty())
+        {
+            lengths[i] = runs[i].front();
+        }
+    }
+    loser_tree<T, Less> tree(readers.size(), less);
+    merge_step<T>(readers, lengths, writer, tree);
+}
+
+/// @brief Sorts the file in memory using the k-way merge sort algorithm with in memory buffers.
 /// @param file_name The name of the file to sort.
 void merge_sorter::sort_file_in_memory(const std::string &file_name)
 {
     // Reads the file into a vector, which we can sort in-memory
-    std::ifstream read_file(file_name);
+    std::ifstream read_file(file_name, std::ios::binary);
     if (!read_file.is_open()) {
         throw std::runtime_error("merge_sorter::sort_file_in_memory: cannot open file for reading: " + file_name);
     }
-    stream_reader<std::string> reader(read_file);
+    token_scanner scanner(read_file);
     std::vector<std::string> data;
-    while (reader.has_next())
+    for (std::string_view token; scanner.next(token);)
     {
-        data.push_back(reader.get());
+        data.emplace_back(token);
     }
     read_file.close();
 
@@ -203,44 +931,172 @@ void merge_sorter::sort_file_in_memory(const std::string &file_name)
     write_file.close();
 }
 
-/// @brief Sorts the vector in memory using the merge sort algorithm with four in memory buffers.
+/// @brief Sorts the vector in memory using the k-way merge sort algorithm with in memory buffers.
 /// @param data The vector to sort.
 void merge_sorter::sort_vec_in_memory(std::vector<value_t> &data)
 {
-    std::unique_ptr<IMergeReader<value_t>> input_reader(std::make_unique<InMemoryReader<value_t>>(std::make_shared<std::vector<value_t>>(data)));
-
-    complete_sort<value_t>(
-        input_reader,
-        std::make_unique<InMemoryWriter<value_t>>(),
-        std::make_unique<InMemoryWriter<value_t>>(),
-        std::make_unique<InMemoryWriter<value_t>>(),
-        std::make_unique<InMemoryWriter<value_t>>());
+    sort_in_memory(data, std::less<>());
+}
 
-    // Write the data from input_reader back to data vector
-    data.clear();
-    while (!input_reader->is_exhausted())
-    {
-        data.push_back(input_reader->get());
-        input_reader->advance();
-    }
+/// @brief Sorts records in memory by their key fields, keeping records with equal keys in order.
+/// @param records The records to sort.
+/// @param order The key fields and their comparison.
+void merge_sorter::sort_records_in_memory(std::vector<value_t> &records, const record_order &order)
+{
+    // A reference keeps the comparator cheap to copy into loser trees and std::stable_sort
+    sort_in_memory(records, std::cref(order));
 }
 
-/// @brief Sorts the file on disk using the merge sort algorithm with four on disk buffers.
+/// @brief Sorts the file on disk using the k-way merge sort algorithm with on disk buffers.
 /// @param file_name The name of the file to sort.
 void merge_sorter::sort_file_on_disk(const std::string &file_name)
 {
-    std::unique_ptr<IMergeReader<value_t>> input_reader(
-        std::make_unique<FileMergeReader<value_t>>(
+    std::unique_ptr<IMergeReader<std::string_view>> input_reader(
+        std::make_unique<FileMergeReader<std::string_view>>(
             file_name
         )
     );
+    sort_on_disk(std::move(input_reader), file_name, [](const std::string &output)
+                 { return std::make_unique<FileMergeWriter<std::string_view>>(output); }, std::less<>(), "tokens");
+}
 
-    complete_sort<value_t>(
-        input_reader,
-        std::make_unique<FileMergeWriter<value_t>>("buffer_a.txt"),
-        std::make_unique<FileMergeWriter<value_t>>("buffer_b.txt"),
-        std::make_unique<FileMergeWriter<value_t>>("buffer_c.txt"),
-        std::make_unique<FileMergeWriter<value_t>>("buffer_d.txt"));
+/// @brief Sorts the lines of a file on disk by their key fields, keeping records with equal keys in order.
+/// @param file_name The name of the file to sort.
+/// @param order The key fields and their comparison.
+void merge_sorter::sort_records_on_disk(const std::string &file_name, const record_order &order)
+{
+    std::unique_ptr<IMergeReader<std::string_view>> input_reader(std::make_unique<LineMergeReader<std::string_view>>(file_name));
+    sort_on_disk(std::move(input_reader), file_name, [](const std::string &output)
+                 { return std::make_unique<LineMergeWriter<std::string_view>>(output); }, std::cref(order), "records " + order.describe());
+}
 
-    // Data is already written back to original file
-}
\ No newline at end of file
+template <typename Less>
+void merge_sorter::sort_in_memory(std::vector<value_t> &data, const Less &less)
+{
+    // The buffers move the elements around, data itself is handed over and taken back without copies
+    std::unique_ptr<IMergeReader<value_t>> input_reader(std::make_unique<InMemoryReader<value_t>>(std::make_shared<std::vector<value_t>>(std::move(data))));
+
+    writer_list<value_t> buffers;
+    for (size_t i = 0; i < 2 * fan_in(); i++)
+    {
+        buffers.push_back(std::make_unique<InMemoryWriter<value_t>>());
+    }
+    complete_sort<value_t>(input_reader, std::move(buffers), 0, nullptr, less);
+
+    // Take the sorted vector back from input_reader
+    data = static_cast<InMemoryReader<value_t> &>(*input_reader).release();
+}
+
+/// Name of the scratch directory of a resumable sort of a file, the same for every attempt.
+static std::string resume_directory_name(const std::string &file_name)
+{
+    std::string const path = std::filesystem::absolute(file_name).string();
+    std::ostringstream name;
+    name << "merge_sort_" << std::filesystem::path(file_name).filename().string() << '_' << std::hex << run_format::crc32(path.data(), path.size()) << ".resume";
+    return name.str();
+}
+
+/// Size and time of last write of a file, telling whether a checkpoint was taken of the same input.
+static std::string file_identity(const std::string &file_name)
+{
+    return std::to_string(std::filesystem::file_size(file_name)) + ' ' + std::to_string(std::filesystem::last_write_time(file_name).time_since_epoch().count());
+}
+
+template <typename Less>
+void merge_sorter::sort_on_disk(std::unique_ptr<IMergeReader<std::string_view>> source, const std::string &file_name, const output_factory &make_output, const Less &less, const std::string &ordering)
+{
+    // Merge passes only move views into the mapped runs, no element is copied into a std::string
+    using view_t = std::string_view;
+    size_t const k = fan_in();
+
+    // Declared before the buffers, so it is removed only after they are closed.
+    // A resumable sort finds its directory again by name and keeps it until the sort succeeded.
+    std::filesystem::path const temp_directory = _options.temp_directory.empty() ? std::filesystem::path(file_name).parent_path() : _options.temp_directory;
+    scratch_directory scratch = _options.resumable ? scratch_directory::reusable(temp_directory, resume_directory_name(file_name), true)
+                                                   : scratch_directory(temp_directory, _options.cleanup != cleanup_policy::always);
+    auto run_file = [&scratch](size_t i)
+    {
+        return scratch.file("buffer_" + std::to_string(i) + ".run");
+    };
+    auto run_writer = [&](size_t i)
+    {
+        // Runs of a resumable sort are flushed to the disk as they are closed, before a checkpoint refers to them;
+        // the writers of later passes are recycled from their readers and stay durable
+        return std::make_unique<BinaryMergeWriter<view_t>>(run_file(i), _options.block_size, false, _options.io_queue_depth, _options.compress_runs, _options.resumable);
+    };
+    std::unique_ptr<thread_pool> pool;
+    if (threads() > 1)
+    {
+        pool = std::make_unique<thread_pool>(threads());
+    }
+
+    // The runs of the last completed pass are in run files first_reader .. first_reader + k - 1, the others are overwritten next
+    sort_manifest progress;
+    progress.input = file_identity(file_name);
+    progress.settings = ordering + " fan_in " + std::to_string(k) +
+                        " natural_runs " + std::to_string(_options.natural_runs) + " duplicates " + std::to_string(static_cast<int>(_options.duplicates));
+    std::string const manifest_file = scratch.file("manifest");
+    auto checkpoint = [&](const run_lengths &runs)
+    {
+        if (!_options.resumable)
+        {
+            return;
+        }
+        progress.runs = runs;
+        progress.save(manifest_file);
+    };
+
+    reader_list<view_t> readers;
+    writer_list<view_t> writers;
+    run_lengths runs;
+    std::optional<sort_manifest> saved = _options.resumable ? sort_manifest::load(manifest_file) : std::nullopt;
+    if (saved && saved->input == progress.input && saved->settings == progress.settings && saved->runs.size() == k)
+    {
+        progress = std::move(*saved);
+        runs = progress.runs;
+        for (size_t i = 0; i < k; i++)
+        {
+            readers.push_back(std::make_unique<MappedMergeReader<view_t>>(run_file(progress.first_reader + i), _options.block_size, _options.io_queue_depth,
+                                                                           _options.resumable));
+            writers.push_back(run_writer(k - progress.first_reader + i));
+        }
+    }
+    else
+    {
+        if (_options.resumable)
+        {
+            scratch.clear(); // left behind by a sort of another input or with other settings
+        }
+        writer_list<view_t> formed;
+        for (size_t i = 0; i < k; i++)
+        {
+            formed.push_back(run_writer(i));
+            writers.push_back(run_writer(k + i));
+        }
+        runs = memory_budget() > 0 ? form_runs(*source, formed, memory_budget(), pool.get(), less) : split(*source, formed, less);
+        for (auto &writer : formed)
+        {
+            readers.push_back(writer->into_reader());
+        }
+        checkpoint(runs);
+    }
+
+    auto pass_done = [&](const run_lengths &merged)
+    {
+        progress.passes++;
+        progress.first_reader = k - progress.first_reader;
+        checkpoint(merged);
+    };
+    sort<view_t>(readers, writers, runs, pool.get(), less, pass_done);
+
+    // Merge the remaining runs into a new file, which replaces the input once it is complete and on the disk
+    source.reset(); // the input is consumed and must not be open while it is replaced
+    atomic_file output(file_name);
+    {
+        auto writer = make_output(output.path());
+        merge_final(readers, runs, *writer, less);
+        writer->into_reader(); // closes the file, throws if writing failed
+    }
+    output.commit();
+    scratch.keep(_options.cleanup == cleanup_policy::never);
+}
@@ -2,13 +2,31 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <deque>
+#include <filesystem>
+#include <span>
+#include <functional>
+
+#include "loser_tree.hpp"
 
 // Forward declarations to break circular dependency between interfaces
 template<typename T> class IMergeReader;
 template<typename T> class IMergeWriter;
+template<typename T> class InMemoryReader;
+template<typename T> class InMemoryWriter;
+class thread_pool;
+class record_order;
+
+/// Type owning the data of an element: std::string for std::string_view, T itself otherwise.
+/// Needed wherever elements outlive the reader position they came from.
+template<typename T> struct owned { using type = T; };
+template<> struct owned<std::string_view> { using type = std::string; };
+template<typename T> using owned_t = typename owned<T>::type;
 
 /// Generic interface for reading elements in merge operations.
+/// For view types (std::string_view) get() returns a view that stays valid until the next advance().
 template<typename T>
 class IMergeReader {
 public:
@@ -25,6 +43,28 @@ public:
 
     /// Converts this reader into an IMergeWriter, allowing the buffer to be reused for writing.
     virtual std::unique_ptr<IMergeWriter<T>> into_writer() = 0;
+
+    /// Copies up to out.size() values, starting with the current one, into out and advances past them.
+    /// Returns the number of values copied, 0 only once exhausted; a short batch does not mean the end.
+    /// Views copied out stay valid until the next call on this reader. The default copies get() and advances,
+    /// which suits owning types and readers whose views outlive advance(); readers whose views die with
+    /// advance() override it and end the batch where their buffer ends (file, binary and compressed runs).
+    virtual std::size_t next_batch(std::span<T> out) {
+        std::size_t count = 0;
+        while (count < out.size() && !is_exhausted()) {
+            out[count++] = get();
+            advance();
+        }
+        return count;
+    }
+
+    /// Splits the remaining elements into independent readers over consecutive runs of the given lengths,
+    /// so the runs can be merged concurrently; this reader is exhausted afterwards.
+    /// The run readers cannot be converted into writers and must be destroyed before this reader is.
+    /// Returns an empty list (and leaves this reader untouched) if the reader cannot be split.
+    virtual std::vector<std::unique_ptr<IMergeReader<T>>> split_runs([[maybe_unused]] const std::deque<std::size_t>& lengths) {
+        return {};
+    }
 };
 
 /// Generic interface for writing (appending) elements in merge operations.
@@ -36,107 +76,386 @@ public:
     /// Appends a value at the writer's position.
     virtual bool append(const T& value) = 0;
 
+    /// Appends all values in order; returns false if any of them could not be appended.
+    virtual bool append_batch(std::span<const T> values) {
+        for (const T& value : values) {
+            if (!append(value)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     /// Converts this writer into an IMergeReader, allowing the written data to be read.
     virtual std::unique_ptr<IMergeReader<T>> into_reader() = 0;
 };
 
 /// <summary>
 /// Orchestrates merge sort over pluggable readers/writers (in-memory or on-disk).
-/// Uses iterative two-way merging with doubling run-size.
+/// Uses balanced k-way merging: every pass merges k runs at once through a loser tree,
+/// so n elements take about log_k(n) passes instead of log_2(n).
+/// On disk the source is first cut into sorted runs as large as the memory budget,
+/// which leaves only log_k(n / run size) merge passes.
+/// With several threads, every run is sorted in parallel pieces and the merges of a pass
+/// that write to different buffers run concurrently.
 /// </summary>
 class merge_sorter {
 public:
     using value_t = std::string;
     using size_t = std::size_t;
 
+    /// <summary>
+    /// Upper bound for the fan-in. Wider merges hardly save passes but every run needs
+    /// its own open reader and writer.
+    /// </summary>
+    static constexpr size_t max_fan_in = 32;
+
+    /// <summary>
+    /// Memory used to sort runs before merging them, also bounding the stream buffers of all open runs.
+    /// </summary>
+    static constexpr size_t default_memory_budget = size_t{64} << 20;
+
+    /// <summary>
+    /// Buffer memory per open run (reader or writer), also the block size of binary run files.
+    /// </summary>
+    static constexpr size_t run_buffer_bytes = size_t{1} << 20;
+
+    /// <summary>
+    /// Blocks every on-disk run reads ahead or writes behind on a background thread (double buffering),
+    /// so merging overlaps with I/O. 0 makes all I/O synchronous.
+    /// </summary>
+    static constexpr size_t default_io_queue_depth = 2;
+
+    /// <summary>
+    /// Worker threads sorting and merging runs; 0 uses one per hardware thread.
+    /// </summary>
+    static constexpr size_t default_threads = 0;
+
+    /// <summary>
+    /// Shortest run split_natural hands out for in-memory input; shorter natural runs are extended by insertion.
+    /// </summary>
+    static constexpr size_t natural_min_run = 32;
+
+    /// <summary>
+    /// What happens to the scratch directory of sort_file_on_disk once the sort is over.
+    /// </summary>
+    enum class cleanup_policy {
+        always,     // removed after every sort
+        on_success, // kept for inspection if the sort failed
+        never,      // always kept
+    };
+
+    /// <summary>
+    /// What happens to elements that are equal under the ordering, from run formation on through every merge pass.
+    /// Equal elements meet in input order, because all merges are stable.
+    /// </summary>
+    enum class duplicate_policy {
+        keep,    // all of them are kept
+        drop,    // only the first one is kept, like sort -u
+        combine, // they are folded into one with options::reduce, like sort | uniq -c
+    };
+
+    /// <summary>
+    /// Folds two equal elements (the folded ones so far and the next one) into one; see record_order::summing.
+    /// </summary>
+    using reduce_fn = std::function<value_t(std::string_view, std::string_view)>;
+
+    /// <summary>
+    /// Settings of a sorter; every field has a usable default.
+    /// </summary>
+    struct options {
+        /// Runs merged at once (at least 2); 0 picks default_fan_in for memory budget, queue depth and block size.
+        size_t fan_in = 0;
+        /// Bytes of elements sorted in memory per initial run of sort_file_on_disk.
+        size_t memory_budget = default_memory_budget;
+        /// Block size of the run files, each open run buffers one block plus io_queue_depth queued ones.
+        size_t block_size = run_buffer_bytes;
+        /// Blocks queued per run for asynchronous I/O; 0 makes all I/O synchronous.
+        size_t io_queue_depth = default_io_queue_depth;
+        /// Worker threads of sort_file_on_disk; 0 uses one per hardware thread, 1 sorts serially.
+        size_t threads = default_threads;
+        /// Every sort_file_on_disk creates a uniquely named scratch directory for its runs in here.
+        /// Empty uses the directory of the sorted file.
+        std::filesystem::path temp_directory;
+        cleanup_policy cleanup = cleanup_policy::always;
+        /// Checkpoint sort_file_on_disk and sort_records_on_disk after run formation and every merge pass, in a scratch
+        /// directory named after the sorted file. Started again with the same settings, an interrupted sort resumes
+        /// from the last completed pass. The directory is kept when the sort fails, whatever the cleanup policy.
+        bool resumable = false;
+        /// Compress the blocks of the run files (run_format::flag_compressed). Trades CPU time for a fraction of
+        /// the disk traffic per pass; pays off when the disk, not the merge, is the bottleneck.
+        bool compress_runs = false;
+        /// Natural merge sort: keep the ascending and strictly descending runs already present in the input
+        /// instead of cutting it blindly, so sorted or nearly sorted input needs few or no merge passes.
+        bool natural_runs = false;
+        duplicate_policy duplicates = duplicate_policy::keep;
+        /// Required for duplicate_policy::combine.
+        reduce_fn reduce;
+    };
+
+    /// <summary>
+    /// Create a sorter merging fan_in runs per pass, with defaults for all other settings.
+    /// </summary>
+    /// <param name="fan_in">Runs merged at once (at least 2); 0 picks default_fan_in(memory_budget, io_queue_depth).</param>
+    /// <param name="memory_budget">Bytes of elements sorted in memory per initial run of sort_file_on_disk.</param>
+    /// <param name="io_queue_depth">Blocks of run_buffer_bytes queued per run for asynchronous I/O.</param>
+    /// <param name="threads">Worker threads of sort_file_on_disk; 0 uses one per hardware thread, 1 sorts serially.</param>
+    explicit merge_sorter(size_t fan_in = 0, size_t memory_budget = default_memory_budget, size_t io_queue_depth = default_io_queue_depth,
+                          size_t threads = default_threads);
+
+    /// <summary>
+    /// Create a sorter from a complete set of options; throws std::invalid_argument for a fan-in below 2, block size 0
+    /// or duplicate_policy::combine without a reduce function.
+    /// </summary>
+    explicit merge_sorter(options settings);
+
+    /// <summary>
+    /// Largest sensible fan-in for this process: every pass keeps k readers and k writers open,
+    /// so k is bounded by the open file limit, by the memory budget for their buffers and by max_fan_in.
+    /// </summary>
+    /// <param name="memory_budget">Memory available for the buffers of all open runs.</param>
+    /// <param name="io_queue_depth">Blocks queued per run in addition to the one in use.</param>
+    /// <param name="block_size">Bytes per block.</param>
+    static size_t default_fan_in(size_t memory_budget = default_memory_budget, size_t io_queue_depth = default_io_queue_depth,
+                                 size_t block_size = run_buffer_bytes);
+
+    /// <summary>
+    /// All settings, with fan-in and threads resolved to the values in use.
+    /// </summary>
+    const options& settings() const noexcept { return _options; }
+
+    /// <summary>
+    /// Number of runs merged per pass.
+    /// </summary>
+    size_t fan_in() const noexcept { return _options.fan_in; }
+
+    /// <summary>
+    /// Memory budget for the initial runs, in bytes.
+    /// </summary>
+    size_t memory_budget() const noexcept { return _options.memory_budget; }
+
+    /// <summary>
+    /// Blocks queued per on-disk run for asynchronous I/O.
+    /// </summary>
+    size_t io_queue_depth() const noexcept { return _options.io_queue_depth; }
+
+    /// <summary>
+    /// Worker threads used by sort_file_on_disk.
+    /// </summary>
+    size_t threads() const noexcept { return _options.threads; }
+
     /// <summary>
     /// Read tokens from a file into memory, sort them, and write back.
     /// </summary>
     /// <param name="file_name">Path to the file to be sorted.</param>
     void sort_file_in_memory(const std::string& file_name);
     /// <summary>
-    /// Sort a vector of tokens in-memory using four in-memory buffers.
+    /// Sort a vector of tokens in-memory using 2 * fan_in in-memory buffers.
     /// </summary>
     /// <param name="data">Container to sort in-place.</param>
     void sort_vec_in_memory(std::vector<value_t>& data);
     /// <summary>
-    /// Sort tokens stored in a file using on-disk buffers only.
+    /// Sort tokens stored in a file using 2 * fan_in on-disk buffers only.
+    /// The buffers use the binary run format and are merged as memory mapped std::string_views,
+    /// only the sorted file is written as text. They live in a scratch directory of their own
+    /// below options::temp_directory, so concurrent sorts never share a file.
+    /// The sorted file is written next to the original, flushed to the disk and renamed over it,
+    /// so a sort that fails or is interrupted leaves the original file untouched.
     /// </summary>
     /// <param name="file_name">Path to the file to be sorted.</param>
     void sort_file_on_disk(const std::string& file_name);
+    /// <summary>
+    /// Sort records (lines) in memory by the keys of order; records with equal keys keep their order.
+    /// </summary>
+    /// <param name="records">Container to sort in-place.</param>
+    /// <param name="order">Key fields and their comparison.</param>
+    void sort_records_in_memory(std::vector<value_t>& records, const record_order& order);
+    /// <summary>
+    /// Sort the lines of a text file (CSV/TSV records) by the keys of order on disk, like sort -s -t -k.
+    /// Lines are merged as views into the memory mapped runs and compared by their projected key fields only.
+    /// Records with equal keys keep their order; every line of the sorted file ends with "\n".
+    /// Replaces the file as atomically as sort_file_on_disk. A resumable sort must be resumed with the same order.
+    /// </summary>
+    /// <param name="file_name">Path to the file to be sorted.</param>
+    /// <param name="order">Key fields and their comparison.</param>
+    void sort_records_on_disk(const std::string& file_name, const record_order& order);
 private:
+    template<typename T>
+    using reader_list = std::vector<std::unique_ptr<IMergeReader<T>>>;
+
+    template<typename T>
+    using writer_list = std::vector<std::unique_ptr<IMergeWriter<T>>>;
+
+    /// <summary>
+    /// Lengths of the sorted runs stored one after another in each buffer, in write order.
+    /// </summary>
+    using run_lengths = std::vector<std::deque<size_t>>;
+
     /// <summary>
-    /// Perform iterative merge passes on two sorted readers, alternating output to two writers.
-    /// Doubles <c>chunk_size</c> each pass and swaps reader/writer roles in between.
+    /// Creates the writer of a sorted file of the kind of its input, given the path to write it to.
+    /// </summary>
+    using output_factory = std::function<std::unique_ptr<IMergeWriter<std::string_view>>(const std::string&)>;
+
+    /// <summary>
+    /// Sort a vector in memory using 2 * fan_in in-memory buffers.
+    /// </summary>
+    template<typename Less>
+    void sort_in_memory(std::vector<value_t>& data, const Less& less);
+
+    /// <summary>
+    /// Sort the elements of source into a new file replacing file_name, using 2 * fan_in binary run files in a scratch
+    /// directory. With options::resumable the progress is checkpointed, and a matching checkpoint is resumed;
+    /// ordering describes less, a checkpoint taken with another ordering is not resumed.
+    /// </summary>
+    template<typename Less>
+    void sort_on_disk(std::unique_ptr<IMergeReader<std::string_view>> source, const std::string& file_name, const output_factory& make_output,
+                      const Less& less, const std::string& ordering);
+
+    /// <summary>
+    /// Perform k-way merge passes over the readers, writing the merged runs round-robin to the writers.
+    /// Swaps reader/writer roles in between until every reader holds at most one run.
     /// </summary>
     /// <typeparam name="T">Element type.</typeparam>
-    /// <param name="reader_l">Left input reader.</param>
-    /// <param name="reader_r">Right input reader.</param>
-    /// <param name="writer_l">Left output writer.</param>
-    /// <param name="writer_r">Right output writer.</param>
-    /// <param name="total_size">Total number of elements across both inputs.</param>
-    template<typename T>
-    void sort(
-        std::unique_ptr<IMergeReader<T>>& reader_l,
-        std::unique_ptr<IMergeReader<T>>& reader_r,
-        std::unique_ptr<IMergeWriter<T>>& writer_l,
-        std::unique_ptr<IMergeWriter<T>>& writer_r,
-        size_t total_size
-    );
+    /// <typeparam name="Less">Strict weak ordering of the elements.</typeparam>
+    /// <param name="readers">k input readers, holding the sorted runs of the last pass on return.</param>
+    /// <param name="writers">k output writers, the spare buffers on return.</param>
+    /// <param name="runs">Run lengths of the readers, updated to the final runs.</param>
+    /// <param name="pool">Workers for concurrent merges, nullptr merges serially.</param>
+    /// <param name="less">Ordering of the elements.</param>
+    /// <param name="pass_done">Called with the run lengths after every pass, once the new runs are closed
+    /// and before the runs of the previous pass are overwritten.</param>
+    template<typename T, typename Less>
+    void sort(reader_list<T>& readers, writer_list<T>& writers, run_lengths& runs, thread_pool* pool, const Less& less,
+              const std::function<void(const run_lengths&)>& pass_done = {});
 
     /// <summary>
-    /// Complete sort pipeline using four buffers: split, iterative sort, final merge back to source.
+    /// Complete sort pipeline using 2k buffers: run formation (or split), iterative k-way sort, final merge back to source.
     /// </summary>
     /// <typeparam name="T">Element type.</typeparam>
+    /// <typeparam name="Less">Strict weak ordering of the elements.</typeparam>
     /// <param name="unsorted_source">Source reader to be sorted (re-seated to sorted data on return).</param>
-    /// <param name="buffer1">Temporary writer buffer.</param>
-    /// <param name="buffer2">Temporary writer buffer.</param>
-    /// <param name="buffer3">Temporary writer buffer.</param>
-    /// <param name="buffer4">Temporary writer buffer.</param>
-    template<typename T>
-    void complete_sort(
-        std::unique_ptr<IMergeReader<T>>& unsorted_source,
-        std::unique_ptr<IMergeWriter<T>> buffer1,
-        std::unique_ptr<IMergeWriter<T>> buffer2,
-        std::unique_ptr<IMergeWriter<T>> buffer3,
-        std::unique_ptr<IMergeWriter<T>> buffer4
-    );
+    /// <param name="buffers">2k temporary writer buffers.</param>
+    /// <param name="run_memory">Bytes per initially sorted run; 0 splits into runs of single elements.</param>
+    /// <param name="pool">Workers for sorting and merging runs, nullptr works serially.</param>
+    /// <param name="less">Ordering of the elements.</param>
+    template<typename T, typename Less>
+    void complete_sort(std::unique_ptr<IMergeReader<T>>& unsorted_source, writer_list<T> buffers, size_t run_memory, thread_pool* pool, const Less& less);
+
+    /// <summary>
+    /// Merge the at most one run left in every reader into the writer.
+    /// </summary>
+    template<typename T, typename Less>
+    void merge_final(reader_list<T>& readers, const run_lengths& runs, IMergeWriter<T>& writer, const Less& less);
 
     /// <summary>
-    /// Alternating run merge: merge runs of size <c>chunk_size</c> from two sorted inputs into
-    /// two writers by alternating target after each merged run.
+    /// One merge pass: merge the next run of every reader into one run, appended to
+    /// the writers in turn, until all runs are consumed.
     /// </summary>
     /// <typeparam name="T">Element type.</typeparam>
-    /// <param name="sorted_l">Left sorted reader.</param>
-    /// <param name="sorted_r">Right sorted reader.</param>
-    /// <param name="writer_l">Left writer target.</param>
-    /// <param name="writer_r">Right writer target.</param>
-    /// <param name="chunk_size">Max elements per run taken from each side.</param>
-    template<typename T>
-    void merge(IMergeReader<T>& sorted_l, IMergeReader<T>& sorted_r, IMergeWriter<T>& writer_l, IMergeWriter<T>& writer_r, size_t chunk_size);
+    /// <typeparam name="Less">Strict weak ordering of the elements.</typeparam>
+    /// <param name="readers">Sorted input readers.</param>
+    /// <param name="runs_in">Run lengths of the readers; consumed.</param>
+    /// <param name="writers">Writer targets.</param>
+    /// <param name="runs_out">Receives the run lengths of the writers.</param>
+    /// <param name="pool">Workers for concurrent merges, nullptr merges serially.</param>
+    /// <param name="less">Ordering of the elements.</param>
+    template<typename T, typename Less>
+    void merge(reader_list<T>& readers, run_lengths& runs_in, writer_list<T>& writers, run_lengths& runs_out, thread_pool* pool, const Less& less);
+
+    /// <summary>
+    /// Parallel merge pass: every reader is split into one reader per run (see IMergeReader::split_runs),
+    /// then one task per writer performs the merges targeting it, in order.
+    /// Returns false without consuming anything if a reader cannot be split.
+    /// </summary>
+    template<typename T, typename Less>
+    bool merge_concurrently(reader_list<T>& readers, run_lengths& runs_in, writer_list<T>& writers, run_lengths& runs_out, thread_pool& pool, const Less& less);
 
-    /// Returns the number of elements read from the reader.
     /// <summary>
-    /// Split input elements alternately into two writers (round-robin: L, R, L, R, ...).
+    /// Split input elements alternately into the writers (round-robin), every element forming a run of length one.
+    /// With options::natural_runs the existing runs of the input are distributed instead (see split_natural).
     /// </summary>
     /// <typeparam name="T">Element type.</typeparam>
+    /// <typeparam name="Less">Strict weak ordering of the elements.</typeparam>
     /// <param name="reader">Source reader.</param>
-    /// <param name="writer_l">Left writer.</param>
-    /// <param name="writer_r">Right writer.</param>
-    /// <returns>Total number of elements observed.</returns>
-    template<typename T>
-    long long split(IMergeReader<T>& reader, IMergeWriter<T>& writer_l, IMergeWriter<T>& writer_r);
+    /// <param name="writers">Writers to distribute to.</param>
+    /// <param name="less">Ordering of the elements, used by split_natural.</param>
+    /// <returns>Run lengths of the writers.</returns>
+    template<typename T, typename Less>
+    run_lengths split(IMergeReader<T>& reader, writer_list<T>& writers, const Less& less);
+
+    /// <summary>
+    /// Natural split: every maximal ascending run of the input goes to the next writer (round-robin).
+    /// In-memory input also turns strictly descending runs around and extends runs shorter than
+    /// natural_min_run by insertion, as TimSort does; other readers cannot look back, so they only detect ascending runs.
+    /// </summary>
+    /// <typeparam name="T">Element type.</typeparam>
+    /// <typeparam name="Less">Strict weak ordering of the elements.</typeparam>
+    /// <param name="reader">Source reader.</param>
+    /// <param name="writers">Writers to distribute to.</param>
+    /// <param name="less">Ordering of the elements.</param>
+    /// <returns>Run lengths of the writers.</returns>
+    template<typename T, typename Less>
+    run_lengths split_natural(IMergeReader<T>& reader, writer_list<T>& writers, const Less& less);
+
+    /// <summary>
+    /// Run formation: repeatedly fill run_memory bytes with input elements, sort them in memory
+    /// and write them as one run to the next writer (round-robin).
+    /// With options::natural_runs, sorted or reversed chunks skip the sort, and every run is extended
+    /// by the following elements as long as none of them is smaller than the last one written.
+    /// </summary>
+    /// <typeparam name="T">Element type.</typeparam>
+    /// <typeparam name="Less">Strict weak ordering of the elements.</typeparam>
+    /// <param name="reader">Source reader.</param>
+    /// <param name="writers">Writers to distribute the runs to.</param>
+    /// <param name="run_memory">Bytes of elements per run; a run holds at least one element.</param>
+    /// <param name="pool">Workers sorting pieces of each run, nullptr sorts serially.</param>
+    /// <param name="less">Ordering of the elements.</param>
+    /// <returns>Run lengths of the writers.</returns>
+    template<typename T, typename Less>
+    run_lengths form_runs(IMergeReader<T>& reader, writer_list<T>& writers, size_t run_memory, thread_pool* pool, const Less& less);
+
+    /// <summary>
+    /// Sort the elements of one run and append them to a writer. With a pool, pieces of the run are
+    /// sorted concurrently and merged into the writer with a loser tree.
+    /// The sort is stable for every ordering but std::less<>, under which equal elements are indistinguishable.
+    /// </summary>
+    template<typename T, typename Less>
+    void write_sorted_run(std::vector<owned_t<T>>& run, IMergeWriter<T>& writer, thread_pool* pool, const Less& less);
 
     /// <summary>
-    /// Merge a single run from each input reader into a writer.
-    /// Consumes up to <c>chunk_size</c> per side or until exhaustion.
+    /// Merge a single run from each input reader into a writer with a loser tree.
+    /// Consumes exactly lengths[i] elements of reader i (or until it is exhausted).
     /// </summary>
     /// <typeparam name="T">Element type.</typeparam>
-    /// <param name="reader_l">Left input reader.</param>
-    /// <param name="reader_r">Right input reader.</param>
+    /// <typeparam name="Less">Strict weak ordering of the elements.</typeparam>
+    /// <param name="readers">Input readers.</param>
+    /// <param name="lengths">Length of the current run of each reader.</param>
     /// <param name="writer">Destination writer.</param>
-    /// <param name="chunk_size">Max elements to take from each reader.</param>
-    /// <returns>True if any reader still has elements; otherwise false.</returns>
-    template<typename T>
-    bool merge_step(IMergeReader<T>& reader_l, IMergeReader<T>& reader_r, IMergeWriter<T>& writer, size_t chunk_size);
+    /// <param name="tree">Selection tree with one leaf per reader, reused between steps.</param>
+    /// <returns>Number of elements written.</returns>
+    template<typename T, typename Less>
+    size_t merge_step(reader_list<T>& readers, const std::vector<size_t>& lengths, IMergeWriter<T>& writer, loser_tree<T, Less>& tree);
+
+    /// <summary>
+    /// merge_step for in-memory buffers, statically dispatched on the concrete (final) buffer types:
+    /// merges the unread ranges of the readers' vectors straight into the writer's vector.
+    /// </summary>
+    /// <typeparam name="T">Element type.</typeparam>
+    /// <typeparam name="Less">Strict weak ordering of the elements.</typeparam>
+    /// <param name="readers">Input readers; nullptr entries must have length 0.</param>
+    /// <param name="lengths">Length of the current run of each reader.</param>
+    /// <param name="writer">Destination writer.</param>
+    /// <param name="less">Ordering of the elements.</param>
+    /// <returns>Number of elements written.</returns>
+    template<typename T, typename Less>
+    size_t merge_step_in_memory(const std::vector<InMemoryReader<T>*>& readers, const std::vector<size_t>& lengths, InMemoryWriter<T>& writer, const Less& less);
+
+    /// <summary>
+    /// Apply options::duplicates to the sorted elements values[first..] in place.
+    /// </summary>
+    /// <returns>Number of elements left behind first.</returns>
+    template<typename T, typename Less>
+    size_t collapse_duplicates(std::vector<T>& values, size_t first, const Less& less);
+
+    options _options;
 };
\ No newline at end of file
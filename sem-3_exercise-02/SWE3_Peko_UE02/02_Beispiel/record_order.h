@@ -0,0 +1,178 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Ordering of delimited text records (CSV/TSV lines) by key fields, like sort -t -k.
+/// Keys are projected as views into the record on every comparison, nothing is copied or parsed up front.
+/// Fields are split at every delimiter, quoting is not supported.
+/// Records with equal keys compare equal, the sorter keeps them in input order.
+/// </summary>
+class record_order {
+public:
+    using size_t = std::size_t;
+
+    /// <summary>
+    /// Three-way comparison of two key fields: negative, zero or positive.
+    /// </summary>
+    using field_compare = std::function<int(std::string_view, std::string_view)>;
+
+    /// <summary>
+    /// One key field; keys are compared in the order given, later keys only break ties.
+    /// </summary>
+    struct key {
+        /// Index of the field, starting at 0; missing fields are empty.
+        size_t column = 0;
+        /// Comparison of the field values; empty compares bytes (see lexicographic).
+        field_compare compare;
+        /// Reverse the order of this key.
+        bool descending = false;
+    };
+
+    /// <summary>
+    /// Create an ordering; without keys whole records are compared byte-wise.
+    /// </summary>
+    /// <param name="delimiter">Field separator, e.g. ',' or '\t'.</param>
+    /// <param name="keys">Key fields, most significant first.</param>
+    explicit record_order(char delimiter = '\t', std::vector<key> keys = {})
+        : _delimiter(delimiter), _keys(std::move(keys)) {
+    }
+
+    /// <summary>
+    /// Byte-wise comparison, the order of std::string_view.
+    /// </summary>
+    static int lexicographic(std::string_view a, std::string_view b) {
+        return a.compare(b);
+    }
+
+    /// <summary>
+    /// Comparison as floating point numbers, like sort -n: leading blanks are skipped and
+    /// a field that does not start with a number counts as 0.
+    /// </summary>
+    static int numeric(std::string_view a, std::string_view b) {
+        double const x = to_number(a);
+        double const y = to_number(b);
+        return x < y ? -1 : (y < x ? 1 : 0);
+    }
+
+    /// <summary>
+    /// Projection of a record to one of its fields; empty if the record has fewer fields.
+    /// </summary>
+    std::string_view field(std::string_view record, size_t column) const {
+        return field(record, column, _delimiter);
+    }
+
+    /// <summary>
+    /// Reduce function for merge_sorter::duplicate_policy::combine, like uniq -c over a count field:
+    /// keeps the first record and adds the integer in field column of the second one to its own.
+    /// Fields that are missing or not integers count as 0.
+    /// </summary>
+    std::function<std::string(std::string_view, std::string_view)> summing(size_t column) const {
+        return [delimiter = _delimiter, column](std::string_view first, std::string_view second) {
+            std::string_view const count = field(first, column, delimiter);
+            if (count.data() == nullptr) {
+                return std::string(first); // no such field to add to
+            }
+            size_t const offset = static_cast<size_t>(count.data() - first.data());
+            long long const sum = to_integer(count) + to_integer(field(second, column, delimiter));
+            std::string combined(first.substr(0, offset));
+            combined += std::to_string(sum);
+            combined += first.substr(offset + count.size());
+            return combined;
+        };
+    }
+
+    /// <summary>
+    /// Three-way comparison of two records by their keys.
+    /// </summary>
+    int compare(std::string_view a, std::string_view b) const {
+        if (_keys.empty()) {
+            return lexicographic(a, b);
+        }
+        for (const key& k : _keys) {
+            std::string_view const x = field(a, k.column);
+            std::string_view const y = field(b, k.column);
+            int const order = k.compare ? k.compare(x, y) : lexicographic(x, y);
+            if (order != 0) {
+                return k.descending ? -order : order;
+            }
+        }
+        return 0;
+    }
+
+    /// <summary>
+    /// Canonical text of the ordering: the delimiter code followed by column, comparison and direction of every key,
+    /// e.g. "delimiter 44 key 2 numeric descending key 0 lexicographic ascending". Custom comparisons are told apart by type only.
+    /// </summary>
+    std::string describe() const {
+        std::string text = "delimiter " + std::to_string(static_cast<unsigned char>(_delimiter));
+        for (const key& k : _keys) {
+            text += " key " + std::to_string(k.column) + ' ' + compare_name(k.compare) + (k.descending ? " descending" : " ascending");
+        }
+        return text;
+    }
+
+    /// <summary>
+    /// Strict weak ordering of records, the comparator handed to merge_sorter.
+    /// </summary>
+    bool operator()(std::string_view a, std::string_view b) const {
+        return compare(a, b) < 0;
+    }
+
+private:
+    static std::string compare_name(const field_compare& compare) {
+        using function_t = int (*)(std::string_view, std::string_view);
+        const function_t* function = compare.target<function_t>();
+        if (!compare || (function && *function == &lexicographic)) {
+            return "lexicographic";
+        }
+        if (function && *function == &numeric) {
+            return "numeric";
+        }
+        return std::string("custom ") + compare.target_type().name();
+    }
+
+    static std::string_view field(std::string_view record, size_t column, char delimiter) {
+        for (; column > 0; column--) {
+            size_t const end = record.find(delimiter);
+            if (end == std::string_view::npos) {
+                return {};
+            }
+            record.remove_prefix(end + 1);
+        }
+        return record.substr(0, record.find(delimiter));
+    }
+
+    static long long to_integer(std::string_view text) {
+        long long value = 0;
+        if (std::from_chars(text.data(), text.data() + text.size(), value).ec != std::errc{}) {
+            return 0;
+        }
+        return value;
+    }
+
+    static double to_number(std::string_view text) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+            text.remove_prefix(1);
+        }
+        if (!text.empty() && text.front() == '+') {
+            text.remove_prefix(1); // from_chars only accepts '-'
+        }
+        double value = 0;
+        if (std::from_chars(text.data(), text.data() + text.size(), value).ec != std::errc{}) {
+            return 0;
+        }
+        return value;
+    }
+
+    char _delimiter;
+    std::vector<key> _keys;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+/// <summary>
+/// Directory of its own for the temporary files of one sort, created with a unique name below a
+/// parent directory, so any number of sorts (threads or processes) can share the same scratch disk.
+/// The directory and everything in it is removed on destruction unless keep() was requested.
+/// </summary>
+class scratch_directory {
+public:
+    /// <summary>
+    /// Create a uniquely named directory; throws std::runtime_error if the parent is not usable.
+    /// </summary>
+    /// <param name="parent">Directory to create it in; empty uses the working directory.</param>
+    /// <param name="keep">Leave the directory behind on destruction.</param>
+    explicit scratch_directory(const std::filesystem::path& parent, bool keep = false)
+        : _keep(keep) {
+        std::error_code error;
+        std::filesystem::path const base = parent.empty() ? std::filesystem::current_path(error) : parent;
+        if (error || !std::filesystem::is_directory(base, error)) {
+            throw std::runtime_error("scratch_directory: not a directory: " + base.string());
+        }
+
+        // create_directory fails for existing names, so a collision just draws another one
+        static std::atomic<std::uint64_t> counter{0};
+        std::random_device seed;
+        for (int attempt = 0; attempt < 16; attempt++) {
+            std::ostringstream name;
+            name << "merge_sort_" << std::hex << seed() << '_' << counter++;
+            std::filesystem::path candidate = base / name.str();
+            if (std::filesystem::create_directory(candidate, error)) {
+                _path = std::move(candidate);
+                return;
+            }
+            if (error) {
+                break;
+            }
+        }
+        throw std::runtime_error("scratch_directory: cannot create a directory in: " + base.string());
+    }
+
+    /// <summary>
+    /// Create the directory with a fixed name below a parent directory, or use it as it is if it exists,
+    /// so a later process finds what an earlier one left behind; throws std::runtime_error if that fails.
+    /// </summary>
+    /// <param name="parent">Directory to create it in; empty uses the working directory.</param>
+    /// <param name="name">Name of the directory.</param>
+    /// <param name="keep">Leave the directory behind on destruction.</param>
+    static scratch_directory reusable(const std::filesystem::path& parent, const std::string& name, bool keep = false) {
+        return scratch_directory(parent, name, keep);
+    }
+
+    /// <summary>
+    /// Remove the directory with its contents unless it is kept; errors are ignored.
+    /// </summary>
+    ~scratch_directory() {
+        if (!_keep) {
+            std::error_code ignored;
+            std::filesystem::remove_all(_path, ignored);
+        }
+    }
+
+    scratch_directory(const scratch_directory&) = delete;
+    scratch_directory& operator=(const scratch_directory&) = delete;
+
+    /// <summary>
+    /// Path of the directory.
+    /// </summary>
+    const std::filesystem::path& path() const noexcept { return _path; }
+
+    /// <summary>
+    /// Path of a file inside the directory.
+    /// </summary>
+    std::string file(const std::string& name) const { return (_path / name).string(); }
+
+    /// <summary>
+    /// Decide whether the directory is left behind on destruction.
+    /// </summary>
+    void keep(bool keep) noexcept { _keep = keep; }
+
+    /// <summary>
+    /// Remove everything in the directory; throws std::filesystem::filesystem_error on failure.
+    /// </summary>
+    void clear() const {
+        for (const auto& entry : std::filesystem::directory_iterator(_path)) {
+            std::filesystem::remove_all(entry.path());
+        }
+    }
+
+private:
+    scratch_directory(const std::filesystem::path& parent, const std::string& name, bool keep)
+        : _keep(keep) {
+        std::error_code error;
+        std::filesystem::path const base = parent.empty() ? std::filesystem::current_path(error) : parent;
+        _path = base / name;
+        std::filesystem::create_directory(_path, error);
+        if (error || !std::filesystem::is_directory(_path, error)) {
+            throw std::runtime_error("scratch_directory: cannot create or use: " + _path.string());
+        }
+    }
+
+    std::filesystem::path _path;
+    bool _keep;
+};
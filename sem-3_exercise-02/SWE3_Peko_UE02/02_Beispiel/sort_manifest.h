@@ -0,0 +1,98 @@
+#pragma once
+
+#include "durable_file.h"
+
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Progress of a resumable sort_file_on_disk, saved in its scratch directory after run formation
+/// and after every merge pass. Holds everything needed to continue with the next pass:
+/// which half of the 2k run files holds the runs of the last completed pass and how long they are.
+/// </summary>
+struct sort_manifest {
+    /// Identity of the input file (size and time of last write); a changed input is sorted from scratch.
+    std::string input;
+    /// Settings the run files depend on; other settings start over.
+    std::string settings;
+    /// Completed merge passes, 0 right after run formation.
+    std::size_t passes = 0;
+    /// The runs are in the run files first_reader .. first_reader + k - 1.
+    std::size_t first_reader = 0;
+    /// Lengths of the runs in each of those files, in write order.
+    std::vector<std::deque<std::size_t>> runs;
+
+    /// <summary>
+    /// Write the manifest to a file, replacing a previous one only once it is completely on the disk.
+    /// </summary>
+    void save(const std::string& file_name) const {
+        atomic_file file(file_name);
+        std::ofstream out(file.path(), std::ios::binary);
+        out << header << '\n'
+            << "input " << input << '\n'
+            << "settings " << settings << '\n'
+            << "passes " << passes << '\n'
+            << "first_reader " << first_reader << '\n';
+        for (const auto& lengths : runs) {
+            out << "runs " << lengths.size();
+            for (std::size_t length : lengths) {
+                out << ' ' << length;
+            }
+            out << '\n';
+        }
+        out.close();
+        if (out.fail()) {
+            throw std::runtime_error("sort_manifest: cannot write: " + file.path());
+        }
+        file.commit();
+    }
+
+    /// <summary>
+    /// Read a manifest written by save(); empty if there is none or it is not readable.
+    /// </summary>
+    static std::optional<sort_manifest> load(const std::string& file_name) {
+        std::ifstream in(file_name, std::ios::binary);
+        std::string line;
+        if (!std::getline(in, line) || line != header) {
+            return std::nullopt;
+        }
+        sort_manifest manifest;
+        while (std::getline(in, line)) {
+            std::size_t const space = line.find(' ');
+            std::string const key = line.substr(0, space);
+            std::string const value = space == std::string::npos ? std::string() : line.substr(space + 1);
+            std::istringstream numbers(value);
+            if (key == "input") {
+                manifest.input = value;
+            } else if (key == "settings") {
+                manifest.settings = value;
+            } else if (key == "passes") {
+                numbers >> manifest.passes;
+            } else if (key == "first_reader") {
+                numbers >> manifest.first_reader;
+            } else if (key == "runs") {
+                std::size_t count = 0;
+                numbers >> count;
+                std::deque<std::size_t>& lengths = manifest.runs.emplace_back(count);
+                for (std::size_t& length : lengths) {
+                    numbers >> length;
+                }
+            } else {
+                return std::nullopt;
+            }
+            if (numbers.fail()) {
+                return std::nullopt;
+            }
+        }
+        return manifest;
+    }
+
+private:
+    static constexpr const char* header = "merge_sort manifest 1";
+};
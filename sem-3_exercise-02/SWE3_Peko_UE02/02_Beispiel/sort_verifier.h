@@ -0,0 +1,141 @@
+#pragma once
+
+#include "merge_sort.hpp"
+#include "token_scanner.h"
+#include "line_merge_buffer.cpp"
+#include "record_order.h"
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/// <summary>
+/// Fingerprint of the elements of a file: their number, their total size, an order-independent hash
+/// of the multiset and where the order breaks. The multiset hash is the sum (mod 2^64) of the element hashes,
+/// so it is the same for every permutation, while a lost or duplicated element changes it.
+/// </summary>
+struct sort_digest {
+    /// Number of elements.
+    std::uint64_t count = 0;
+    /// Bytes of all elements, without separators.
+    std::uint64_t bytes = 0;
+    /// Sum of sort_verifier::hash over all elements.
+    std::uint64_t multiset_hash = 0;
+    /// Elements smaller than their predecessor.
+    std::uint64_t unsorted = 0;
+    /// Index of the first element smaller than its predecessor; only valid if unsorted > 0.
+    std::uint64_t first_unsorted = 0;
+
+    /// <summary>
+    /// True if no element is smaller than its predecessor.
+    /// </summary>
+    bool sorted() const noexcept { return unsorted == 0; }
+
+    /// <summary>
+    /// True if both digests were taken over the same multiset of elements (up to hash collisions).
+    /// </summary>
+    bool same_elements(const sort_digest& other) const noexcept {
+        return count == other.count && bytes == other.bytes && multiset_hash == other.multiset_hash;
+    }
+
+    /// <summary>
+    /// True if this digest of a sorted file proves it is a sorted permutation of the input digested before.
+    /// Sorts dropping or combining duplicates (merge_sorter::duplicate_policy) change the multiset by design.
+    /// </summary>
+    bool is_sorted_permutation_of(const sort_digest& input) const noexcept {
+        return sorted() && same_elements(input);
+    }
+};
+
+/// <summary>
+/// Streaming verification of sorted files: a single pass computes the sort_digest of a file,
+/// reading it through the same block scanners as the sorter, so it runs at about the speed of the disk.
+/// Typical use: digest the input, sort it in place, digest the output and compare.
+/// </summary>
+class sort_verifier {
+public:
+    /// <summary>
+    /// 64 bit hash of an element, mixing 8 bytes at a time.
+    /// </summary>
+    static std::uint64_t hash(std::string_view element) noexcept {
+        std::uint64_t h = 0x9E3779B97F4A7C15ull ^ element.size();
+        std::size_t i = 0;
+        for (; i + 8 <= element.size(); i += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, element.data() + i, 8);
+            h = mix(h ^ word);
+        }
+        if (i < element.size()) {
+            std::uint64_t word = 0;
+            std::memcpy(&word, element.data() + i, element.size() - i);
+            h = mix(h ^ word);
+        }
+        return mix(h);
+    }
+
+    /// <summary>
+    /// Digest of the remaining elements of a reader, checking their order with less.
+    /// </summary>
+    template<typename Less = std::less<>>
+    static sort_digest digest(IMergeReader<std::string_view>& reader, const Less& less = {}) {
+        return digest_sequence([&reader](std::string_view& element) {
+            if (reader.is_exhausted()) {
+                return false;
+            }
+            element = reader.get();
+            reader.advance();
+            return true;
+        }, less);
+    }
+
+    /// <summary>
+    /// Digest of a file of whitespace separated tokens, as sorted by merge_sorter::sort_file_on_disk.
+    /// </summary>
+    static sort_digest digest_tokens(const std::string& file_name) {
+        // straight on the scanner, saving two virtual calls per token
+        token_scanner scanner(file_name);
+        return digest_sequence([&scanner](std::string_view& element) { return scanner.next(element); }, std::less<>{});
+    }
+
+    /// <summary>
+    /// Digest of a file of records (lines), as sorted by merge_sorter::sort_records_on_disk with the same order.
+    /// </summary>
+    static sort_digest digest_records(const std::string& file_name, const record_order& order) {
+        LineMergeReader<std::string_view> reader(file_name);
+        return digest(reader, order);
+    }
+
+private:
+    /// <summary>
+    /// Digest of the elements produced by next(element) until it returns false.
+    /// </summary>
+    template<typename Next, typename Less>
+    static sort_digest digest_sequence(Next next, const Less& less) {
+        sort_digest result;
+        std::string previous; // views handed out by next() do not survive the following call
+        std::string_view element;
+        while (next(element)) {
+            if (result.count > 0 && less(element, std::string_view(previous))) {
+                if (result.unsorted++ == 0) {
+                    result.first_unsorted = result.count;
+                }
+            }
+            result.count++;
+            result.bytes += element.size();
+            result.multiset_hash += hash(element);
+            previous.assign(element);
+        }
+        return result;
+    }
+
+    /// <summary>
+    /// splitmix64 finalizer.
+    /// </summary>
+    static std::uint64_t mix(std::uint64_t z) noexcept {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
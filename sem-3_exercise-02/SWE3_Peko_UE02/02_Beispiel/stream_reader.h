@@ -5,12 +5,17 @@
 #include <sstream>
 #include <stdexcept>
 #include <optional>
+#include <type_traits>
 #include <vector>
 
+#include "token_scanner.h"
+
 /// <summary>
 /// A simple wrapper around a stream that extracts element of type T
 /// using `operator >>`.
 /// It can be constructed, either from a file name or an existing istream.
+/// std::string tokens are split by a token_scanner instead, which reads the stream ahead in blocks;
+/// use token_scanner directly to get the tokens as views without any allocation.
 /// </summary>
 /// <typeparam name="T">type of the elements to be extracted from the stream</typeparam>
 template <typename T>
@@ -55,19 +60,29 @@ public:
 
 private:
   std::optional<T> next();
+  bool extract(T& value);
   std::optional<T> buffer;
 
   std::optional<std::fstream> m_fin;
   std::istream &m_in;
+  std::optional<token_scanner> m_scanner; // only for std::string
 };
 
 template<typename T>
 inline stream_reader<T>::stream_reader(const std::string& file_name)
-  : m_fin{ std::optional<std::fstream>(file_name) }, m_in(m_fin.value()) {}
+  : m_fin{ std::optional<std::fstream>(file_name) }, m_in(m_fin.value()) {
+  if constexpr (std::is_same_v<T, std::string>) {
+    m_scanner.emplace(m_in);
+  }
+}
 
 template<typename T>
 inline stream_reader<T>::stream_reader(std::istream& stream)
-  : m_in{ stream } { }
+  : m_in{ stream } {
+  if constexpr (std::is_same_v<T, std::string>) {
+    m_scanner.emplace(m_in);
+  }
+}
 
 template<typename T>
 inline T stream_reader<T>::get() {
@@ -81,10 +96,8 @@ inline T stream_reader<T>::get() {
 
 template<typename T>
 inline T stream_reader<T>::peek() {
-  std::optional<T> value = next(); // empties buffer
-  if (value.has_value()) {
-    buffer = value; // put (back) into buffer
-    return value.value();
+  if (has_next()) { // fills buffer
+    return *buffer;
   } else {
     throw std::underflow_error("cannot peek() after end of stream");
   }
@@ -94,7 +107,7 @@ template<typename T>
 inline bool stream_reader<T>::has_next() {
     if (buffer) return true;
     T tmp;
-    if (m_in >> tmp) {           // only true when a token was actually read
+    if (extract(tmp)) {          // only true when a token was actually read
         buffer = std::move(tmp); // stash it for next()
         return true;
     }
@@ -109,6 +122,15 @@ inline std::optional<T> stream_reader<T>::next() {
         return v;
     }
     T tmp;
-    if (m_in >> tmp) return tmp; // succeed → return token
-    return std::nullopt;         // fail → no token
+    if (extract(tmp)) return tmp; // succeed → return token
+    return std::nullopt;          // fail → no token
+}
+
+template<typename T>
+inline bool stream_reader<T>::extract(T& value) {
+    if constexpr (std::is_same_v<T, std::string>) {
+        return m_scanner->next(value);
+    } else {
+        return static_cast<bool>(m_in >> value);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TOKEN_SCANNER_SSE2 1
+#endif
+
+/// <summary>
+/// Fast splitter of a stream into whitespace separated tokens, the hot path behind stream_reader&lt;std::string&gt;.
+/// Reads large blocks with a single read() each and hands out std::string_views into the block,
+/// so no token is allocated or copied; tokens crossing a block boundary are moved to the front of the next block.
+/// Whitespace is ASCII whitespace (" \t\n\v\f\r", as in the "C" locale), token ends are found 16 bytes at a time with SSE2.
+/// The scanner reads ahead, so the stream position is unspecified while it is in use.
+/// </summary>
+class token_scanner {
+public:
+    using size_t = std::size_t;
+
+    /// <summary>
+    /// Bytes read per block; the buffer grows for tokens longer than that.
+    /// </summary>
+    static constexpr size_t default_block_size = size_t{1} << 20;
+
+    /// <summary>
+    /// Open a file for scanning; throws std::runtime_error if it cannot be opened.
+    /// </summary>
+    /// <param name="file_name">Path of the file to scan.</param>
+    /// <param name="block_size">Bytes read at once.</param>
+    explicit token_scanner(const std::string& file_name, size_t block_size = default_block_size)
+        : _file(std::in_place, file_name, std::ios::binary), _in(&*_file), _buffer(std::max<size_t>(block_size, 1)) {
+        if (!_file->is_open()) {
+            throw std::runtime_error("token_scanner: cannot open file for reading: " + file_name);
+        }
+    }
+
+    /// <summary>
+    /// Scan an existing stream, which must outlive the scanner.
+    /// </summary>
+    /// <param name="stream">Stream to read tokens from.</param>
+    /// <param name="block_size">Bytes read at once.</param>
+    explicit token_scanner(std::istream& stream, size_t block_size = default_block_size)
+        : _in(&stream), _buffer(std::max<size_t>(block_size, 1)) {
+    }
+
+    token_scanner(const token_scanner&) = delete;
+    token_scanner& operator=(const token_scanner&) = delete;
+
+    /// <summary>
+    /// Find the next token. The view stays valid until the next call or until the scanner is destroyed.
+    /// </summary>
+    /// <returns>false at the end of the stream.</returns>
+    bool next(std::string_view& token) {
+        while (true) {
+            while (_pos < _end && is_space(_buffer[_pos])) {
+                _pos++;
+            }
+            if (_pos == _end) {
+                if (!refill()) {
+                    return false;
+                }
+                continue;
+            }
+            size_t const stop = find_space(_buffer.data(), _pos, _end);
+            if (stop == _end && !_eof) {
+                refill(); // the token may go on in the next block
+                continue;
+            }
+            token = std::string_view(_buffer.data() + _pos, stop - _pos);
+            _pos = stop;
+            return true;
+        }
+    }
+
+    /// <summary>
+    /// Find the next token only if it lies completely in the current block, so no read moves the block
+    /// and the views handed out before stay valid. Returns false otherwise, the next call of next() finds it.
+    /// </summary>
+    bool next_buffered(std::string_view& token) {
+        size_t start = _pos;
+        while (start < _end && is_space(_buffer[start])) {
+            start++;
+        }
+        if (start == _end) {
+            return false;
+        }
+        size_t const stop = find_space(_buffer.data(), start, _end);
+        if (stop == _end && !_eof) {
+            return false; // the token may go on in the next block
+        }
+        token = std::string_view(_buffer.data() + start, stop - start);
+        _pos = stop;
+        return true;
+    }
+
+    /// <summary>
+    /// Find the next token and assign it to token, reusing its capacity.
+    /// </summary>
+    /// <returns>false at the end of the stream, token is left untouched then.</returns>
+    bool next(std::string& token) {
+        std::string_view view;
+        if (!next(view)) {
+            return false;
+        }
+        token.assign(view);
+        return true;
+    }
+
+    /// <summary>
+    /// ASCII whitespace, the characters std::isspace accepts in the "C" locale.
+    /// </summary>
+    static bool is_space(char c) noexcept {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    /// <summary>
+    /// Index of the first whitespace in data[pos, end), end if there is none.
+    /// </summary>
+    static size_t find_space(const char* data, size_t pos, size_t end) noexcept {
+#ifdef TOKEN_SCANNER_SSE2
+        // Every whitespace byte is at most 0x20: mark those bytes (unsigned, via min) and check the few candidates
+        __m128i const space = _mm_set1_epi8(0x20);
+        for (; pos + 16 <= end; pos += 16) {
+            __m128i const chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(chunk, space), chunk)));
+            for (; mask != 0; mask &= mask - 1) {
+                size_t const candidate = pos + static_cast<size_t>(std::countr_zero(mask));
+                if (is_space(data[candidate])) {
+                    return candidate;
+                }
+            }
+        }
+#endif
+        while (pos < end && !is_space(data[pos])) {
+            pos++;
+        }
+        return pos;
+    }
+
+private:
+    /// <summary>
+    /// Keep the unscanned bytes, moved to the front, and append the next block after them.
+    /// Returns false if nothing could be read.
+    /// </summary>
+    bool refill() {
+        if (_eof) {
+            return false;
+        }
+        if (_pos > 0) {
+            std::memmove(_buffer.data(), _buffer.data() + _pos, _end - _pos);
+            _end -= _pos;
+            _pos = 0;
+        }
+        if (_end == _buffer.size()) {
+            _buffer.resize(2 * _buffer.size()); // a token larger than the block
+        }
+        _in->read(_buffer.data() + _end, static_cast<std::streamsize>(_buffer.size() - _end));
+        auto const count = static_cast<size_t>(_in->gcount());
+        _end += count;
+        _eof = !*_in;
+        return count > 0;
+    }
+
+    std::optional<std::ifstream> _file;
+    std::istream* _in;
+    std::vector<char> _buffer;
+    size_t _pos = 0; // first unscanned byte
+    size_t _end = 0; // end of the bytes read
+    bool _eof = false;
+};
@@ -4,7 +4,17 @@
 #include "../02_Beispiel/random.cpp" // Dont know why, but we have to import .cpp instead of .h for Test project to build
 #include "../02_Beispiel/stream_reader.h"
 #include "../02_Beispiel/file_manipulator.cpp"
+#include "../02_Beispiel/thread_pool.cpp"
+#include "../02_Beispiel/sort_verifier.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <sstream>
 #include <stdexcept>
+#include <thread>
 
 constexpr int TEST_STRING_LENGTHS[] = {10, 100};
 constexpr int TEST_ARRAY_LENGTHS[] = {100000, 1000000};
@@ -208,3 +218,1386 @@ TEST(MergeSortTest, TestNonexistentFileInMemoryThrows) {
     ASSERT_THROW(sorter.sort_file_in_memory(filename), std::runtime_error);
 }
 
+
+TEST(MergeSortTest, TestKWayMergeWithOddFanInOnDisk) {
+    // Arrange
+    std::string filename = "k_way_test_file_on_disk.txt";
+    file_manipulator::fill_randomly(filename, 1000, 3);
+    std::vector<std::string> expected;
+    {
+        std::ifstream file(filename);
+        stream_reader<std::string> reader(file);
+        while (reader.has_next()) {
+            expected.push_back(reader.get());
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    // Act
+    merge_sorter sorter(3);
+    sorter.sort_file_on_disk(filename);
+
+    // Assert
+    std::ifstream input_file(filename);
+    stream_reader<std::string> reader(input_file);
+    std::vector<std::string> actual;
+    while (reader.has_next()) {
+        actual.push_back(reader.get());
+    }
+    ASSERT_EQ(expected, actual) << "k-way merge must keep every element and sort them";
+
+    // Clean up
+    input_file.close();
+    remove(filename.c_str());
+}
+
+TEST(MergeSortTest, TestKWayMergeInMemory) {
+    // Arrange
+    std::vector<std::string> data;
+    for (int i = 0; i < 5000; i++) {
+        data.push_back(random_string(random_int(1, 8)));
+    }
+    std::vector<std::string> expected(data);
+    std::sort(expected.begin(), expected.end());
+
+    // Act
+    merge_sorter sorter(5);
+    sorter.sort_vec_in_memory(data);
+
+    // Assert
+    ASSERT_EQ(expected, data);
+}
+
+TEST(MergeSortTest, TestFanInBelowTwoThrows) {
+    ASSERT_THROW(merge_sorter(1), std::invalid_argument);
+    ASSERT_GE(merge_sorter::default_fan_in(), 2u);
+    ASSERT_LE(merge_sorter::default_fan_in(), merge_sorter::max_fan_in);
+}
+
+TEST(LoserTreeTest, TestPopsSmallestAndPrefersLowerSourceOnTies) {
+    // Arrange
+    loser_tree<int> tree(3);
+    tree.set(0, 5);
+    tree.set(1, 2);
+    tree.set(2, 2);
+    tree.build();
+
+    // Act + Assert
+    ASSERT_EQ(1u, tree.top());
+    tree.replace_top(7);
+    ASSERT_EQ(2u, tree.top());
+    tree.pop_top();
+    ASSERT_EQ(0u, tree.top());
+    ASSERT_EQ(5, tree.top_value());
+    tree.pop_top();
+    ASSERT_EQ(1u, tree.top());
+    tree.pop_top();
+    ASSERT_TRUE(tree.empty());
+}
+
+TEST(MergeSortTest, TestRunFormationWithSmallMemoryBudgetOnDisk) {
+    // Arrange
+    std::string filename = "run_formation_test_file_on_disk.txt";
+    file_manipulator::fill_randomly(filename, 20000, 6);
+    std::vector<std::string> expected;
+    {
+        std::ifstream file(filename);
+        stream_reader<std::string> reader(file);
+        while (reader.has_next()) {
+            expected.push_back(reader.get());
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    // Act: 4 KiB runs with fan-in 4 need several merge passes
+    merge_sorter sorter(4, 4096);
+    sorter.sort_file_on_disk(filename);
+
+    // Assert
+    std::ifstream input_file(filename);
+    stream_reader<std::string> reader(input_file);
+    std::vector<std::string> actual;
+    while (reader.has_next()) {
+        actual.push_back(reader.get());
+    }
+    ASSERT_EQ(expected, actual);
+
+    // Clean up
+    input_file.close();
+    remove(filename.c_str());
+}
+
+TEST(BinaryMergeBufferTest, TestRoundTripAcrossBlocks) {
+    // Arrange: tiny blocks force many block boundaries, one record exceeds the block size
+    std::string filename = "binary_round_trip.run";
+    std::vector<std::string> values = {"alpha", "", "a b\nc", std::string(100, 'x'), "omega"};
+    BinaryMergeWriter<std::string> writer(filename, 16, true);
+    for (const auto& value : values) {
+        writer.append(value);
+    }
+
+    // Act
+    auto reader = writer.into_reader();
+    std::vector<std::string> actual;
+    while (!reader->is_exhausted()) {
+        actual.push_back(reader->get());
+        reader->advance();
+    }
+
+    // Assert
+    ASSERT_EQ(values, actual);
+
+    // Clean up
+    reader.reset();
+    remove(filename.c_str());
+}
+
+TEST(BinaryMergeBufferTest, TestRecycledWritersStayDurable) {
+    // Arrange: later merge passes write into writers recycled from the readers of the previous pass
+    std::string binary_file = "binary_durable.run";
+    std::string mapped_file = "mapped_durable.run";
+    std::unique_ptr<IMergeWriter<std::string>> binary = std::make_unique<BinaryMergeWriter<std::string>>(binary_file, 16, false, 2, false, true);
+    std::unique_ptr<IMergeWriter<std::string_view>> mapped = std::make_unique<BinaryMergeWriter<std::string_view>>(mapped_file, 16, false, 2, true, true);
+    std::unique_ptr<IMergeWriter<std::string>> volatile_writer = std::make_unique<BinaryMergeWriter<std::string>>("binary_volatile.run");
+
+    for (int pass = 0; pass < 3; pass++) {
+        // Act
+        binary->append("alpha");
+        binary = binary->into_reader()->into_writer();
+        mapped->append("omega");
+        mapped = mapped->into_reader()->into_writer();
+        volatile_writer = volatile_writer->into_reader()->into_writer();
+
+        // Assert
+        ASSERT_TRUE(dynamic_cast<BinaryMergeWriter<std::string>&>(*binary).durable());
+        ASSERT_TRUE(dynamic_cast<BinaryMergeWriter<std::string_view>&>(*mapped).durable());
+        ASSERT_FALSE(dynamic_cast<BinaryMergeWriter<std::string>&>(*volatile_writer).durable());
+    }
+
+    // Clean up
+    binary.reset();
+    mapped.reset();
+    volatile_writer.reset();
+    remove(binary_file.c_str());
+    remove(mapped_file.c_str());
+    remove("binary_volatile.run");
+}
+
+TEST(BinaryMergeBufferTest, TestChecksumMismatchThrows) {
+    // Arrange
+    std::string filename = "binary_corrupt.run";
+    {
+        BinaryMergeWriter<std::string> writer(filename, 1024, true);
+        writer.append("hello");
+        writer.append("world");
+    }
+    {
+        std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-1, std::ios::end);
+        file.put('W');
+    }
+
+    // Act + Assert
+    ASSERT_THROW(BinaryMergeReader<std::string> reader(filename), std::runtime_error);
+
+    // Clean up
+    remove(filename.c_str());
+}
+
+TEST(MappedMergeBufferTest, TestViewsPointIntoMappingAndStayValid) {
+    // Arrange
+    std::string filename = "mapped_round_trip.run";
+    std::vector<std::string> values = {"alpha", "", "a b\nc", std::string(100, 'x'), "omega"};
+    BinaryMergeWriter<std::string_view> writer(filename, 16, true);
+    for (const auto& value : values) {
+        writer.append(value);
+    }
+
+    // Act: collect views without copying, they must survive advancing the reader
+    auto reader = writer.into_reader();
+    ASSERT_NE(nullptr, dynamic_cast<MappedMergeReader<std::string_view>*>(reader.get()));
+    std::vector<std::string_view> views;
+    while (!reader->is_exhausted()) {
+        views.push_back(reader->get());
+        reader->advance();
+    }
+
+    // Assert
+    ASSERT_EQ(values.size(), views.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        ASSERT_EQ(values[i], views[i]);
+    }
+
+    // Clean up
+    views.clear();
+    reader.reset();
+    remove(filename.c_str());
+}
+
+TEST(AsyncBlockIoTest, TestReadAheadKeepsOrderAndRethrows) {
+    // Arrange: 100 one-byte blocks, then a failing read
+    int produced = 0;
+    read_ahead prefetcher([&produced](io_block& block) {
+        if (produced == 100) {
+            throw std::runtime_error("disk on fire");
+        }
+        block.assign(1, static_cast<char>(produced++));
+        return true;
+    }, 3);
+
+    // Act + Assert
+    io_block block;
+    for (int i = 0; i < 100; i++) {
+        ASSERT_TRUE(prefetcher.next(block));
+        ASSERT_EQ(static_cast<char>(i), block[0]);
+    }
+    ASSERT_THROW(prefetcher.next(block), std::runtime_error);
+}
+
+TEST(AsyncBlockIoTest, TestWriteBehindWritesEverythingBeforeFinish) {
+    // Arrange
+    std::vector<char> written;
+    write_behind scribe([&written](const io_block& block) {
+        written.insert(written.end(), block.begin(), block.end());
+    }, 2);
+
+    // Act
+    io_block block;
+    std::vector<char> expected;
+    for (int i = 0; i < 100; i++) {
+        block.assign(3, static_cast<char>(i));
+        expected.insert(expected.end(), block.begin(), block.end());
+        scribe.submit(block);
+        ASSERT_TRUE(block.empty());
+    }
+    scribe.finish();
+
+    // Assert
+    ASSERT_EQ(expected, written);
+}
+
+TEST(MergeSortTest, TestSynchronousIoOnDisk) {
+    // Arrange
+    std::string filename = "synchronous_io_test_file_on_disk.txt";
+    file_manipulator::fill_randomly(filename, 5000, 5);
+    std::vector<std::string> expected;
+    {
+        std::ifstream file(filename);
+        stream_reader<std::string> reader(file);
+        while (reader.has_next()) {
+            expected.push_back(reader.get());
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    // Act: queue depth 0 disables the background I/O threads
+    merge_sorter sorter(3, 2048, 0);
+    sorter.sort_file_on_disk(filename);
+
+    // Assert
+    std::ifstream input_file(filename);
+    stream_reader<std::string> reader(input_file);
+    std::vector<std::string> actual;
+    while (reader.has_next()) {
+        actual.push_back(reader.get());
+    }
+    ASSERT_EQ(expected, actual);
+
+    // Clean up
+    input_file.close();
+    remove(filename.c_str());
+}
+
+TEST(MappedMergeBufferTest, TestSplitRunsAcrossBlocks) {
+    // Arrange: 3 records per 32 byte block, runs start mid-block and span whole blocks
+    std::string filename = "mapped_split.run";
+    std::vector<std::string> values;
+    for (int i = 0; i < 40; i++) {
+        values.push_back("r" + std::to_string(100 + i));
+    }
+    BinaryMergeWriter<std::string_view> writer(filename, 32, true);
+    for (const auto& value : values) {
+        writer.append(value);
+    }
+    auto reader = writer.into_reader();
+
+    // Act
+    std::deque<size_t> lengths = {1, 0, 10, 2, 27};
+    auto runs = reader->split_runs(lengths);
+
+    // Assert
+    ASSERT_TRUE(reader->is_exhausted());
+    ASSERT_EQ(lengths.size(), runs.size());
+    size_t next = 0;
+    for (size_t r = 0; r < runs.size(); r++) {
+        for (size_t i = 0; i < lengths[r]; i++) {
+            ASSERT_FALSE(runs[r]->is_exhausted());
+            ASSERT_EQ(values[next++], runs[r]->get());
+            runs[r]->advance();
+        }
+        ASSERT_TRUE(runs[r]->is_exhausted());
+    }
+    ASSERT_THROW(runs[0]->into_writer(), std::logic_error);
+
+    // Clean up
+    runs.clear();
+    reader.reset();
+    remove(filename.c_str());
+}
+
+TEST(MergeSortTest, TestParallelSortOnDisk) {
+    // Arrange
+    std::string filename = "parallel_test_file_on_disk.txt";
+    file_manipulator::fill_randomly(filename, 200000, 6);
+    std::vector<std::string> expected;
+    {
+        std::ifstream file(filename);
+        stream_reader<std::string> reader(file);
+        while (reader.has_next()) {
+            expected.push_back(reader.get());
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    // Act: 1 MiB runs are sorted in 4 pieces, fan-in 3 needs several concurrent merge passes
+    merge_sorter sorter(3, size_t{1} << 20, merge_sorter::default_io_queue_depth, 4);
+    sorter.sort_file_on_disk(filename);
+
+    // Assert
+    std::ifstream input_file(filename);
+    stream_reader<std::string> reader(input_file);
+    std::vector<std::string> actual;
+    while (reader.has_next()) {
+        actual.push_back(reader.get());
+    }
+    ASSERT_EQ(expected, actual);
+
+    // Clean up
+    input_file.close();
+    remove(filename.c_str());
+}
+
+TEST(MergeSortTest, TestConcurrentSortsShareTempDirectory) {
+    // Arrange: both sorts use the same scratch disk
+    std::filesystem::path temp_directory = "shared_scratch_test_dir";
+    std::filesystem::create_directory(temp_directory);
+    std::vector<std::string> filenames = {"concurrent_a_test_file_on_disk.txt", "concurrent_b_test_file_on_disk.txt"};
+    std::vector<std::vector<std::string>> expected;
+    for (const auto& filename : filenames) {
+        file_manipulator::fill_randomly(filename, 20000, 5);
+        std::ifstream file(filename);
+        stream_reader<std::string> reader(file);
+        std::vector<std::string> values;
+        while (reader.has_next()) {
+            values.push_back(reader.get());
+        }
+        std::sort(values.begin(), values.end());
+        expected.push_back(std::move(values));
+    }
+
+    // Act
+    merge_sorter::options settings;
+    settings.fan_in = 3;
+    settings.memory_budget = 4096;
+    settings.block_size = 1024;
+    settings.temp_directory = temp_directory;
+    std::vector<std::thread> sorts;
+    for (const auto& filename : filenames) {
+        sorts.emplace_back([&settings, &filename] { merge_sorter(settings).sort_file_on_disk(filename); });
+    }
+    for (auto& sort : sorts) {
+        sort.join();
+    }
+
+    // Assert: both sorted, no scratch files left behind
+    for (size_t i = 0; i < filenames.size(); i++) {
+        std::ifstream input_file(filenames[i]);
+        stream_reader<std::string> reader(input_file);
+        std::vector<std::string> actual;
+        while (reader.has_next()) {
+            actual.push_back(reader.get());
+        }
+        ASSERT_EQ(expected[i], actual);
+    }
+    ASSERT_TRUE(std::filesystem::is_empty(temp_directory));
+
+    // Clean up
+    for (const auto& filename : filenames) {
+        remove(filename.c_str());
+    }
+    std::filesystem::remove_all(temp_directory);
+}
+
+TEST(MergeSortTest, TestCleanupPolicyNeverKeepsScratchFiles) {
+    // Arrange
+    std::filesystem::path temp_directory = "kept_scratch_test_dir";
+    std::filesystem::create_directory(temp_directory);
+    std::string filename = "kept_scratch_test_file_on_disk.txt";
+    file_manipulator::fill_randomly(filename, 1000, 5);
+    merge_sorter::options settings;
+    settings.fan_in = 2;
+    settings.temp_directory = temp_directory;
+    settings.cleanup = merge_sorter::cleanup_policy::never;
+
+    // Act
+    merge_sorter(settings).sort_file_on_disk(filename);
+
+    // Assert: one scratch directory holding the 2 * fan_in run files
+    std::vector<std::filesystem::path> scratch(std::filesystem::directory_iterator(temp_directory), {});
+    ASSERT_EQ(1u, scratch.size());
+    ASSERT_EQ(4, std::distance(std::filesystem::directory_iterator(scratch[0]), {}));
+
+    // Clean up
+    remove(filename.c_str());
+    std::filesystem::remove_all(temp_directory);
+}
+
+TEST(MergeBufferTest, TestBatchesMatchElementwiseAccess) {
+    // Arrange: the in-memory buffers copy ranges, binary buffers loop over their records
+    std::vector<std::string> values;
+    for (int i = 0; i < 1000; i++) {
+        values.push_back(random_string(random_int(0, 12)));
+    }
+    std::string filename = "batch_test.run";
+    std::vector<std::unique_ptr<IMergeWriter<std::string>>> writers;
+    writers.push_back(std::make_unique<InMemoryWriter<std::string>>());
+    writers.push_back(std::make_unique<BinaryMergeWriter<std::string>>(filename, 256));
+
+    for (auto& writer : writers) {
+        // Act: write in two batches, read back in batches of 7
+        ASSERT_TRUE(writer->append_batch(std::span<const std::string>(values).first(400)));
+        ASSERT_TRUE(writer->append_batch(std::span<const std::string>(values).subspan(400)));
+        auto reader = writer->into_reader();
+        std::vector<std::string> actual;
+        std::vector<std::string> batch(7);
+        while (size_t count = reader->next_batch(batch)) {
+            actual.insert(actual.end(), batch.begin(), batch.begin() + count);
+        }
+
+        // Assert
+        ASSERT_EQ(values, actual);
+        ASSERT_TRUE(reader->is_exhausted());
+    }
+
+    // Clean up
+    writers.clear();
+    remove(filename.c_str());
+}
+
+TEST(MergeBufferTest, TestViewBatchesStayValidUntilNextCall) {
+    // Arrange: readers whose views die with advance() end their batches where their block ends
+    std::vector<std::string> values;
+    for (int i = 0; i < 200000; i++) {
+        values.push_back(random_string(random_int(1, 12)));
+    }
+    std::string run_file = "view_batch_test.run";
+    std::string compressed_file = "view_batch_test_compressed.run";
+    std::string token_file = "view_batch_test_tokens.txt";
+    {
+        BinaryMergeWriter<std::string_view> plain(run_file, 64);
+        BinaryMergeWriter<std::string_view> compressed(compressed_file, 64, true, 2, true);
+        std::ofstream tokens(token_file, std::ios::binary);
+        for (const auto& value : values) {
+            plain.append(value);
+            compressed.append(value);
+            tokens << value << (value.size() % 3 == 0 ? "\n" : " ");
+        }
+        plain.into_reader();
+        compressed.into_reader();
+    }
+    std::vector<std::unique_ptr<IMergeReader<std::string_view>>> readers;
+    readers.push_back(std::make_unique<BinaryMergeReader<std::string_view>>(run_file, 64));
+    readers.push_back(std::make_unique<MappedMergeReader<std::string_view>>(compressed_file, 64));
+    readers.push_back(std::make_unique<FileMergeReader<std::string_view>>(token_file)); // blocks of 1 MiB
+
+    for (auto& reader : readers) {
+        // Act: check every batch before the next call, mixing in single element access
+        size_t position = 0;
+        std::vector<std::string_view> batch(50);
+        for (int call = 0; size_t count = reader->next_batch(batch); call++) {
+            for (size_t i = 0; i < count; i++) {
+                ASSERT_EQ(values[position + i], batch[i]);
+            }
+            position += count;
+            if (call % 3 == 0 && !reader->is_exhausted()) {
+                ASSERT_EQ(values[position], reader->get());
+                reader->advance();
+                position++;
+            }
+        }
+
+        // Assert
+        ASSERT_EQ(values.size(), position);
+        ASSERT_TRUE(reader->is_exhausted());
+    }
+
+    // Clean up
+    readers.clear();
+    remove(run_file.c_str());
+    remove(compressed_file.c_str());
+    remove(token_file.c_str());
+}
+
+TEST(MergeSortTest, TestTwoWayMergeInMemoryWithDuplicates) {
+    // Arrange
+    std::vector<std::string> data;
+    for (int i = 0; i < 5000; i++) {
+        data.push_back(random_string(random_int(1, 2)));
+    }
+    std::vector<std::string> expected(data);
+    std::sort(expected.begin(), expected.end());
+
+    // Act: fan-in 2 merges every step with std::merge
+    merge_sorter sorter(2);
+    sorter.sort_vec_in_memory(data);
+
+    // Assert
+    ASSERT_EQ(expected, data);
+}
+
+TEST(MergeSortTest, TestInMemorySortMovesInsteadOfCopying) {
+    // Arrange: strings too long for the small string buffer own their characters on the heap
+    std::vector<std::string> data;
+    for (int i = 0; i < 3000; i++) {
+        data.push_back(random_string(64));
+    }
+    std::vector<std::string> expected(data);
+    std::sort(expected.begin(), expected.end());
+
+    for (size_t fan_in : {2, 3, 6}) {
+        // Act
+        std::vector<std::string> sorted(data);
+        std::vector<const char*> sorted_storage;
+        for (const auto& value : sorted) {
+            sorted_storage.push_back(value.data());
+        }
+        std::sort(sorted_storage.begin(), sorted_storage.end());
+        merge_sorter(fan_in).sort_vec_in_memory(sorted);
+
+        // Assert: every string still owns the characters it started with
+        ASSERT_EQ(expected, sorted);
+        std::vector<const char*> after;
+        for (const auto& value : sorted) {
+            after.push_back(value.data());
+        }
+        std::sort(after.begin(), after.end());
+        ASSERT_EQ(sorted_storage, after);
+    }
+}
+
+TEST(MergeSortTest, TestNaturalRunsInMemory) {
+    // Arrange: sorted, reversed, nearly sorted, random and duplicate-heavy input
+    std::vector<std::string> random;
+    for (int i = 0; i < 5000; i++) {
+        random.push_back(random_string(random_int(1, 6)));
+    }
+    std::vector<std::string> sorted(random);
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<std::string> reversed(sorted.rbegin(), sorted.rend());
+    std::vector<std::string> nearly_sorted(sorted);
+    for (size_t i = 0; i + 7 < nearly_sorted.size(); i += 50) {
+        std::swap(nearly_sorted[i], nearly_sorted[i + 7]);
+    }
+    std::vector<std::string> duplicates;
+    for (int i = 0; i < 5000; i++) {
+        duplicates.push_back(random_string(1));
+    }
+
+    for (const auto& input : {random, sorted, reversed, nearly_sorted, duplicates}) {
+        std::vector<std::string> expected(input);
+        std::sort(expected.begin(), expected.end());
+        for (size_t fan_in : {2, 5}) {
+            // Act
+            merge_sorter::options settings;
+            settings.fan_in = fan_in;
+            settings.natural_runs = true;
+            std::vector<std::string> actual(input);
+            merge_sorter(settings).sort_vec_in_memory(actual);
+
+            // Assert
+            ASSERT_EQ(expected, actual);
+        }
+    }
+}
+
+TEST(MergeSortTest, TestNaturalRunsOnDisk) {
+    // Arrange: 4 KiB runs would need several merge passes for every input
+    std::string filename = "natural_runs_test_file_on_disk.txt";
+    std::vector<std::string> sorted;
+    for (int i = 0; i < 20000; i++) {
+        sorted.push_back(random_string(6));
+    }
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<std::string> reversed(sorted.rbegin(), sorted.rend());
+    std::vector<std::string> nearly_sorted(sorted);
+    for (size_t i = 0; i + 3 < nearly_sorted.size(); i += 100) {
+        std::swap(nearly_sorted[i], nearly_sorted[i + 3]);
+    }
+    merge_sorter::options settings;
+    settings.fan_in = 2;
+    settings.memory_budget = 4096;
+    settings.natural_runs = true;
+
+    for (const auto& input : {sorted, reversed, nearly_sorted}) {
+        std::ofstream file(filename);
+        for (const auto& value : input) {
+            file << value << ' ';
+        }
+        file.close();
+
+        // Act
+        merge_sorter(settings).sort_file_on_disk(filename);
+
+        // Assert
+        std::ifstream input_file(filename);
+        stream_reader<std::string> reader(input_file);
+        std::vector<std::string> actual;
+        while (reader.has_next()) {
+            actual.push_back(reader.get());
+        }
+        ASSERT_EQ(sorted, actual);
+    }
+
+    // Clean up
+    remove(filename.c_str());
+}
+
+TEST(MergeSortTest, TestNaturalRunsSortedInputSkipsMergePasses) {
+    // Arrange
+    std::filesystem::path temp_directory = "natural_scratch_test_dir";
+    std::filesystem::create_directory(temp_directory);
+    std::string filename = "natural_scratch_test_file_on_disk.txt";
+    std::ofstream file(filename);
+    for (int i = 0; i < 20000; i++) {
+        file << std::setw(6) << std::setfill('0') << i << ' ';
+    }
+    file.close();
+    merge_sorter::options settings;
+    settings.fan_in = 2;
+    settings.memory_budget = 4096;
+    settings.temp_directory = temp_directory;
+    settings.cleanup = merge_sorter::cleanup_policy::never;
+    settings.natural_runs = true;
+
+    // Act
+    merge_sorter(settings).sort_file_on_disk(filename);
+
+    // Assert: the whole input is one run in the first buffer, the spare buffers of the merge passes stay empty
+    std::filesystem::path scratch = *std::filesystem::directory_iterator(temp_directory);
+    auto const first_run = std::filesystem::file_size(scratch / "buffer_0.run");
+    ASSERT_GT(first_run, 20000u * 6);
+    for (const char* spare : {"buffer_1.run", "buffer_2.run", "buffer_3.run"}) {
+        ASSERT_LT(std::filesystem::file_size(scratch / spare), first_run / 100);
+    }
+    std::ifstream input_file(filename);
+    stream_reader<std::string> reader(input_file);
+    for (int i = 0; i < 20000; i++) {
+        ASSERT_TRUE(reader.has_next());
+        ASSERT_EQ(i, std::stoi(reader.get()));
+    }
+    ASSERT_FALSE(reader.has_next());
+
+    // Clean up
+    input_file.close();
+    remove(filename.c_str());
+    std::filesystem::remove_all(temp_directory);
+}
+
+TEST(RecordOrderTest, TestProjectsAndComparesKeyFields) {
+    // Arrange: descending numbers first, then ascending names
+    record_order order(',', {{2, record_order::numeric, true}, {0, record_order::lexicographic}});
+
+    // Act & Assert
+    ASSERT_EQ("b", order.field("a,b,c", 1));
+    ASSERT_EQ("", order.field("a,b", 2));
+    ASSERT_EQ("", order.field("a,,c", 1));
+    ASSERT_TRUE(order("x,1,10", "a,1,9"));
+    ASSERT_TRUE(order("a,1, 9", "b,1,+9"));
+    ASSERT_FALSE(order("b,1,9", "a,2,9.0"));
+    ASSERT_EQ(0, order.compare("a,1,9", "a,2,9"));
+    ASSERT_TRUE(record_order()("a\tz", "b\ta"));
+    ASSERT_EQ("delimiter 44 key 2 numeric descending key 0 lexicographic ascending", order.describe());
+}
+
+TEST(MergeSortTest, TestSortRecordsInMemoryIsStable) {
+    // Arrange: few distinct keys, the sequence number in the second field shows the input order
+    std::vector<std::string> records;
+    for (int i = 0; i < 5000; i++) {
+        records.push_back(random_string(1) + "," + std::to_string(i));
+    }
+    record_order order(',', {{0, record_order::lexicographic}});
+    std::vector<std::string> expected(records);
+    std::stable_sort(expected.begin(), expected.end(), order);
+
+    for (bool natural : {false, true}) {
+        for (size_t fan_in : {2, 5}) {
+            // Act
+            merge_sorter::options settings;
+            settings.fan_in = fan_in;
+            settings.natural_runs = natural;
+            std::vector<std::string> actual(records);
+            merge_sorter(settings).sort_records_in_memory(actual, order);
+
+            // Assert
+            ASSERT_EQ(expected, actual);
+        }
+    }
+}
+
+TEST(MergeSortTest, TestSortRecordsOnDisk) {
+    // Arrange: TSV records, sorted by a numeric column descending, then by name; the id keeps ties apart
+    std::string filename = "records_test_file_on_disk.tsv";
+    std::vector<std::string> records;
+    for (int i = 0; i < 20000; i++) {
+        records.push_back(random_string(random_int(1, 3)) + '\t' + std::to_string(i) + '\t' + std::to_string(random_int(-20, 20)));
+    }
+    record_order order('\t', {{2, record_order::numeric, true}, {0, record_order::lexicographic}});
+    std::vector<std::string> expected(records);
+    std::stable_sort(expected.begin(), expected.end(), order);
+    merge_sorter::options settings;
+    settings.fan_in = 3;
+    settings.memory_budget = 16384; // several runs and merge passes
+    settings.threads = 4;
+
+    for (bool crlf : {false, true}) {
+        std::ofstream file(filename, std::ios::binary);
+        for (const auto& record : records) {
+            file << record << (crlf ? "\r\n" : "\n");
+        }
+        file.close();
+
+        // Act
+        merge_sorter(settings).sort_records_on_disk(filename, order);
+
+        // Assert
+        std::ifstream input_file(filename, std::ios::binary);
+        std::vector<std::string> actual;
+        for (std::string line; std::getline(input_file, line);) {
+            actual.push_back(line);
+        }
+        ASSERT_EQ(expected, actual);
+    }
+
+    // Clean up
+    remove(filename.c_str());
+}
+
+TEST(RecordOrderTest, TestSummingAddsCountFields) {
+    // Arrange
+    record_order order('\t', {{0, record_order::lexicographic}});
+    auto sum = order.summing(1);
+
+    // Act & Assert: the other fields of the first record are kept
+    ASSERT_EQ("a\t5\tx", sum("a\t2\tx", "a\t3\ty"));
+    ASSERT_EQ("a\t-1", sum("a\t1", "a\t-2"));
+    ASSERT_EQ("a\t7", sum("a\tseven", "a\t7"));
+    ASSERT_EQ("a", sum("a", "a\t7"));
+}
+
+TEST(MergeSortTest, TestCombineWithoutReduceThrows) {
+    merge_sorter::options settings;
+    settings.duplicates = merge_sorter::duplicate_policy::combine;
+    ASSERT_THROW(merge_sorter{settings}, std::invalid_argument);
+}
+
+TEST(MergeSortTest, TestDropDuplicates) {
+    // Arrange: two letter tokens repeat a lot
+    std::string filename = "drop_duplicates_test_file_on_disk.txt";
+    std::vector<std::string> data;
+    for (int i = 0; i < 20000; i++) {
+        data.push_back(random_string(random_int(1, 2)));
+    }
+    std::vector<std::string> expected(data);
+    std::sort(expected.begin(), expected.end());
+    expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+    std::ofstream file(filename);
+    for (const auto& value : data) {
+        file << value << ' ';
+    }
+    file.close();
+    merge_sorter::options settings;
+    settings.fan_in = 3;
+    settings.memory_budget = 4096;
+    settings.duplicates = merge_sorter::duplicate_policy::drop;
+
+    // Act
+    merge_sorter(settings).sort_file_on_disk(filename);
+    for (size_t fan_in : {2, 5}) {
+        settings.fan_in = fan_in;
+        std::vector<std::string> actual(data);
+        merge_sorter(settings).sort_vec_in_memory(actual);
+        ASSERT_EQ(expected, actual);
+    }
+
+    // Assert
+    std::ifstream input_file(filename);
+    stream_reader<std::string> reader(input_file);
+    std::vector<std::string> actual;
+    while (reader.has_next()) {
+        actual.push_back(reader.get());
+    }
+    ASSERT_EQ(expected, actual);
+
+    // Clean up
+    input_file.close();
+    remove(filename.c_str());
+}
+
+TEST(MergeSortTest, TestCombineCountsRecords) {
+    // Arrange: a word count, every record counts one occurrence
+    std::string filename = "combine_counts_test_file_on_disk.tsv";
+    std::map<std::string, int> counts;
+    std::vector<std::string> records;
+    for (int i = 0; i < 20000; i++) {
+        std::string word = random_string(random_int(1, 2));
+        counts[word]++;
+        records.push_back(word + "\t1");
+    }
+    std::vector<std::string> expected;
+    for (const auto& [word, count] : counts) {
+        expected.push_back(word + '\t' + std::to_string(count));
+    }
+    std::ofstream file(filename, std::ios::binary);
+    for (const auto& record : records) {
+        file << record << '\n';
+    }
+    file.close();
+    record_order order('\t', {{0, record_order::lexicographic}});
+    merge_sorter::options settings;
+    settings.fan_in = 3;
+    settings.memory_budget = 4096;
+    settings.threads = 4;
+    settings.duplicates = merge_sorter::duplicate_policy::combine;
+    settings.reduce = order.summing(1);
+
+    // Act
+    merge_sorter(settings).sort_records_on_disk(filename, order);
+    for (size_t fan_in : {2, 5}) {
+        settings.fan_in = fan_in;
+        std::vector<std::string> actual(records);
+        merge_sorter(settings).sort_records_in_memory(actual, order);
+        ASSERT_EQ(expected, actual);
+    }
+
+    // Assert
+    std::ifstream input_file(filename, std::ios::binary);
+    std::vector<std::string> actual;
+    for (std::string line; std::getline(input_file, line);) {
+        actual.push_back(line);
+    }
+    ASSERT_EQ(expected, actual);
+
+    // Clean up
+    input_file.close();
+    remove(filename.c_str());
+}
+
+TEST(TokenScannerTest, TestMatchesStreamExtraction) {
+    // Arrange: all kinds of ASCII whitespace, control and UTF-8 bytes inside tokens, tokens longer than a block
+    std::string text = " \t alpha\r\nbeta\v\fgamma  \x01" "delta\xc3\xa4" "epsilon ";
+    for (int i = 0; i < 500; i++) {
+        text += random_string(random_int(1, 40));
+        text += " \n\t"[random_int(0, 2)];
+    }
+    text += std::string(100, 'z') + "\n\n";
+    std::vector<std::string> expected;
+    {
+        std::istringstream stream(text);
+        for (std::string token; stream >> token;) {
+            expected.push_back(token);
+        }
+    }
+
+    for (size_t block_size : {1, 7, 64, 4096}) {
+        // Act
+        std::istringstream stream(text);
+        token_scanner scanner(stream, block_size);
+        std::vector<std::string> actual;
+        for (std::string_view token; scanner.next(token);) {
+            actual.emplace_back(token);
+        }
+
+        // Assert
+        ASSERT_EQ(expected, actual);
+        std::string_view token;
+        ASSERT_FALSE(scanner.next(token));
+    }
+}
+
+TEST(TokenScannerTest, TestStreamReaderPeekAndGet) {
+    // Arrange
+    std::istringstream stream("  one two\tthree\n");
+    stream_reader<std::string> reader(stream);
+
+    // Act & Assert
+    ASSERT_EQ("one", reader.peek());
+    ASSERT_EQ("one", reader.peek());
+    ASSERT_EQ("one", reader.get());
+    ASSERT_EQ("two", reader.get());
+    ASSERT_TRUE(reader.has_next());
+    ASSERT_EQ("three", reader.get());
+    ASSERT_FALSE(reader.has_next());
+    ASSERT_THROW(reader.get(), std::underflow_error);
+}
+
+TEST(FileManipulatorTest, TestBulkFillIsReproducibleForAnyThreadCount) {
+    // Arrange: more than one block of tokens
+    std::string filename = "bulk_fill_test_file.txt";
+    file_manipulator::fill_options options;
+    options.seed = 42;
+    std::vector<std::string> files;
+
+    for (size_t threads : {1, 3}) {
+        // Act
+        options.threads = threads;
+        file_manipulator::fill_bulk(filename, 200000, 7, options);
+        std::ifstream file(filename, std::ios::binary);
+        files.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // Assert: n tokens of len upper case letters, each followed by a space
+    ASSERT_EQ(files[0], files[1]);
+    ASSERT_EQ(200000u * 8, files[0].size());
+    for (size_t i = 0; i < files[0].size(); i++) {
+        if (i % 8 == 7) {
+            ASSERT_EQ(' ', files[0][i]);
+        } else {
+            ASSERT_TRUE(files[0][i] >= 'A' && files[0][i] <= 'Z');
+        }
+    }
+    options.seed = 43;
+    file_manipulator::fill_bulk(filename, 200000, 7, options);
+    std::ifstream file(filename, std::ios::binary);
+    ASSERT_NE(files[0], std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+
+    // Clean up
+    file.close();
+    remove(filename.c_str());
+}
+
+TEST(FileManipulatorTest, TestBulkFillDistributions) {
+    // Arrange
+    std::string filename = "bulk_distribution_test_file.txt";
+    auto read_tokens = [&filename] {
+        std::ifstream file(filename);
+        stream_reader<std::string> reader(file);
+        std::vector<std::string> tokens;
+        while (reader.has_next()) {
+            tokens.push_back(reader.get());
+        }
+        return tokens;
+    };
+    file_manipulator::fill_options options;
+    options.seed = 7;
+    options.threads = 2;
+
+    // Act & Assert: the first 40 % are ascending, the rest is not
+    options.presorted_fraction = 0.4;
+    file_manipulator::fill_bulk(filename, 100000, 5, options);
+    std::vector<std::string> tokens = read_tokens();
+    ASSERT_EQ(100000u, tokens.size());
+    ASSERT_TRUE(std::is_sorted(tokens.begin(), tokens.begin() + 40000));
+    ASSERT_FALSE(std::is_sorted(tokens.begin() + 40000, tokens.end()));
+
+    // Act & Assert: zipf tokens come from the vocabulary, the most frequent one about 1 / H(1000) ~ 13 % of the time
+    options.presorted_fraction = 0;
+    options.dist = file_manipulator::distribution::zipf;
+    options.vocabulary = 1000;
+    file_manipulator::fill_bulk(filename, 100000, 8, options);
+    std::map<std::string, int> counts;
+    for (const auto& token : read_tokens()) {
+        counts[token]++;
+    }
+    ASSERT_LE(counts.size(), 1000u);
+    int most_frequent = 0;
+    for (const auto& [token, count] : counts) {
+        most_frequent = std::max(most_frequent, count);
+    }
+    ASSERT_GT(most_frequent, 11000);
+    ASSERT_LT(most_frequent, 16000);
+
+    // Clean up
+    remove(filename.c_str());
+}
+
+TEST(SortVerifierTest, TestDigestAfterSortOnDisk) {
+    // Arrange
+    std::string filename = "verifier_test_file.txt";
+    file_manipulator::fill_randomly(filename, 50000, 3); // plenty of duplicates
+    sort_digest input = sort_verifier::digest_tokens(filename);
+
+    // Act
+    merge_sorter(0, 65536).sort_file_on_disk(filename);
+    sort_digest output = sort_verifier::digest_tokens(filename);
+
+    // Assert
+    ASSERT_EQ(50000u, input.count);
+    ASSERT_EQ(150000u, input.bytes);
+    ASSERT_FALSE(input.sorted());
+    ASSERT_TRUE(output.is_sorted_permutation_of(input));
+
+    // Clean up
+    remove(filename.c_str());
+}
+
+TEST(SortVerifierTest, TestDetectsDisorderLossAndDuplication) {
+    // Arrange
+    std::string filename = "verifier_broken_test_file.txt";
+    auto digest_of = [&filename](const std::string& content) {
+        std::ofstream(filename) << content;
+        return sort_verifier::digest_tokens(filename);
+    };
+    sort_digest input = digest_of("d b a c b");
+
+    // Act & Assert
+    ASSERT_TRUE(digest_of("a b b c d").is_sorted_permutation_of(input));
+    ASSERT_TRUE(digest_of("  a\nb\tb c  d\n").is_sorted_permutation_of(input)); // separators do not count
+    sort_digest unsorted = digest_of("a b c b d");
+    ASSERT_TRUE(unsorted.same_elements(input));
+    ASSERT_EQ(1u, unsorted.unsorted);
+    ASSERT_EQ(3u, unsorted.first_unsorted);
+    ASSERT_FALSE(digest_of("a b c d").same_elements(input));     // lost a b
+    ASSERT_FALSE(digest_of("a b b b c d").same_elements(input)); // duplicated b
+    ASSERT_FALSE(digest_of("a a c c d").same_elements(input));   // both b turned into other tokens
+    ASSERT_FALSE(digest_of("a b b cd").same_elements(input));    // same bytes, other tokens
+
+    // Clean up
+    remove(filename.c_str());
+}
+
+TEST(SortVerifierTest, TestDigestRecordsUsesRecordOrder) {
+    // Arrange
+    std::string filename = "verifier_records_test_file.tsv";
+    record_order order('\t', {{1, record_order::numeric, true}});
+    std::ofstream(filename, std::ios::binary) << "a\t3\nb\t10\nc\t-2\n";
+    sort_digest input = sort_verifier::digest_records(filename, order);
+
+    // Act
+    merge_sorter().sort_records_on_disk(filename, order);
+    sort_digest output = sort_verifier::digest_records(filename, order);
+
+    // Assert
+    ASSERT_EQ(1u, input.unsorted);
+    ASSERT_TRUE(output.is_sorted_permutation_of(input));
+    ASSERT_FALSE(sort_verifier::digest_records(filename, record_order()).sorted()); // b before a
+
+    // Clean up
+    remove(filename.c_str());
+}
+
+TEST(MergeSortTest, TestFailedSortLeavesInputUntouched) {
+    // Arrange
+    std::filesystem::path temp_directory = "failed_sort_scratch_test_dir";
+    std::filesystem::create_directory(temp_directory);
+    std::string filename = "failed_sort_test_file_on_disk.txt";
+    file_manipulator::fill_randomly(filename, 20000, 2);
+    std::ifstream file(filename, std::ios::binary);
+    std::string const content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    merge_sorter::options settings;
+    settings.fan_in = 2;
+    settings.memory_budget = 4096;
+    settings.temp_directory = temp_directory;
+    settings.duplicates = merge_sorter::duplicate_policy::combine;
+    size_t calls = 0;
+    settings.reduce = [&calls](std::string_view first, std::string_view) -> std::string {
+        if (++calls == 5000) {
+            throw std::runtime_error("interrupted");
+        }
+        return std::string(first);
+    };
+
+    // Act
+    ASSERT_THROW(merge_sorter(settings).sort_file_on_disk(filename), std::runtime_error);
+
+    // Assert: the input is as it was, neither the new file nor the scratch files are left behind
+    std::ifstream input_file(filename, std::ios::binary);
+    ASSERT_EQ(content, std::string((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>()));
+    ASSERT_FALSE(std::filesystem::exists(filename + ".partial"));
+    ASSERT_TRUE(std::filesystem::is_empty(temp_directory));
+
+    // Clean up
+    input_file.close();
+    remove(filename.c_str());
+    std::filesystem::remove_all(temp_directory);
+}
+
+TEST(MergeSortTest, TestFailedConcurrentMergeWaitsForItsTasks) {
+    // Arrange: one of the concurrent merges of a late pass fails while the others keep merging
+    std::filesystem::path temp_directory = "failed_concurrent_merge_scratch_test_dir";
+    std::filesystem::create_directory(temp_directory);
+    std::string filename = "failed_concurrent_merge_test_file_on_disk.txt";
+    std::string reference = "failed_concurrent_merge_reference_test_file_on_disk.txt";
+    file_manipulator::fill_randomly(filename, 50000, 2);
+    std::filesystem::copy_file(filename, reference, std::filesystem::copy_options::overwrite_existing);
+    merge_sorter::options settings;
+    settings.fan_in = 4;
+    settings.memory_budget = 4096;
+    settings.threads = 4;
+    settings.temp_directory = temp_directory;
+    settings.duplicates = merge_sorter::duplicate_policy::combine;
+    std::atomic<size_t> calls = 0;
+    size_t limit = 0;
+    settings.reduce = [&](std::string_view first, std::string_view) -> std::string {
+        if (++calls == limit) {
+            throw std::runtime_error("interrupted");
+        }
+        return std::string(first);
+    };
+    merge_sorter(settings).sort_file_on_disk(reference);
+    limit = calls * 3 / 4;
+    calls = 0;
+
+    // Act: the error is rethrown only after every merge task finished with the buffers
+    ASSERT_THROW(merge_sorter(settings).sort_file_on_disk(filename), std::runtime_error);
+
+    // Assert
+    ASSERT_FALSE(std::filesystem::exists(filename + ".partial"));
+    ASSERT_TRUE(std::filesystem::is_empty(temp_directory));
+
+    // Clean up
+    remove(filename.c_str());
+    remove(reference.c_str());
+    std::filesystem::remove_all(temp_directory);
+}
+
+TEST(MergeSortTest, TestResumableSortContinuesAfterLastCompletedPass) {
+    // Arrange: tokens of 2 letters have many duplicates, combined by a reduce function that counts its calls
+    std::filesystem::path temp_directory = "resumable_scratch_test_dir";
+    std::filesystem::create_directory(temp_directory);
+    std::string filename = "resumable_test_file_on_disk.txt";
+    std::string reference = "resumable_reference_test_file_on_disk.txt";
+    file_manipulator::fill_randomly(filename, 50000, 2);
+    std::filesystem::copy_file(filename, reference, std::filesystem::copy_options::overwrite_existing);
+    merge_sorter::options settings;
+    settings.fan_in = 2;
+    settings.memory_budget = 4096; // many runs, many passes
+    settings.block_size = 1024;
+    settings.threads = 1;
+    settings.temp_directory = temp_directory;
+    settings.duplicates = merge_sorter::duplicate_policy::combine;
+    size_t calls = 0;
+    size_t limit = 0;
+    settings.reduce = [&](std::string_view first, std::string_view) -> std::string {
+        if (++calls == limit) {
+            throw std::runtime_error("interrupted");
+        }
+        return std::string(first);
+    };
+    merge_sorter(settings).sort_file_on_disk(reference);
+    size_t const uninterrupted_calls = calls;
+    settings.resumable = true;
+
+    // Act: interrupt the sort at about two thirds, in a merge pass, then start it again
+    calls = 0;
+    limit = uninterrupted_calls * 2 / 3;
+    ASSERT_THROW(merge_sorter(settings).sort_file_on_disk(filename), std::runtime_error);
+    std::vector<std::filesystem::path> scratch(std::filesystem::directory_iterator(temp_directory), {});
+    ASSERT_EQ(1u, scratch.size());
+    std::optional<sort_manifest> checkpoint = sort_manifest::load((scratch[0] / "manifest").string());
+    ASSERT_TRUE(checkpoint.has_value());
+    ASSERT_GT(checkpoint->passes, 0u);
+    calls = 0;
+    limit = 0;
+    merge_sorter(settings).sort_file_on_disk(filename);
+
+    // Assert: run formation and the completed passes were skipped, the result is the same, the scratch directory is gone
+    ASSERT_LT(calls, uninterrupted_calls);
+    std::ifstream actual(filename, std::ios::binary);
+    std::ifstream expected(reference, std::ios::binary);
+    ASSERT_EQ(std::string((std::istreambuf_iterator<char>(expected)), std::istreambuf_iterator<char>()),
+              std::string((std::istreambuf_iterator<char>(actual)), std::istreambuf_iterator<char>()));
+    ASSERT_TRUE(std::filesystem::is_empty(temp_directory));
+
+    // Clean up
+    actual.close();
+    expected.close();
+    remove(filename.c_str());
+    remove(reference.c_str());
+    std::filesystem::remove_all(temp_directory);
+}
+
+TEST(MergeSortTest, TestResumableSortStartsOverForChangedInput) {
+    // Arrange: a checkpoint of another input with the same name
+    std::filesystem::path temp_directory = "stale_resume_scratch_test_dir";
+    std::filesystem::create_directory(temp_directory);
+    std::string filename = "stale_resume_test_file_on_disk.txt";
+    file_manipulator::fill_randomly(filename, 5000, 4);
+    merge_sorter::options settings;
+    settings.fan_in = 2;
+    settings.memory_budget = 4096;
+    settings.temp_directory = temp_directory;
+    settings.resumable = true;
+    settings.cleanup = merge_sorter::cleanup_policy::never; // keeps the checkpoint of the first input
+    merge_sorter(settings).sort_file_on_disk(filename);
+    file_manipulator::fill_randomly(filename, 3000, 4);
+    sort_digest input = sort_verifier::digest_tokens(filename);
+
+    // Act
+    settings.cleanup = merge_sorter::cleanup_policy::always;
+    merge_sorter(settings).sort_file_on_disk(filename);
+
+    // Assert
+    ASSERT_TRUE(sort_verifier::digest_tokens(filename).is_sorted_permutation_of(input));
+    ASSERT_TRUE(std::filesystem::is_empty(temp_directory));
+
+    // Clean up
+    remove(filename.c_str());
+    std::filesystem::remove_all(temp_directory);
+}
+
+TEST(MergeSortTest, TestResumableSortStartsOverForChangedOrder) {
+    // Arrange: a checkpoint of the same input, interrupted while sorting by name through a comparison that counts its calls
+    std::filesystem::path temp_directory = "reordered_resume_scratch_test_dir";
+    std::filesystem::create_directory(temp_directory);
+    std::string filename = "reordered_resume_test_file_on_disk.tsv";
+    std::string reference = "reordered_resume_reference_test_file_on_disk.tsv";
+    std::vector<std::string> records;
+    std::ofstream file(filename, std::ios::binary);
+    for (int i = 0; i < 20000; i++) {
+        records.push_back(random_string(random_int(1, 3)) + '\t' + std::to_string(random_int(-20, 20)));
+        file << records.back() << '\n';
+    }
+    file.close();
+    std::filesystem::copy_file(filename, reference, std::filesystem::copy_options::overwrite_existing);
+    merge_sorter::options settings;
+    settings.fan_in = 2;
+    settings.memory_budget = 4096; // many runs, many passes
+    settings.threads = 1;
+    settings.temp_directory = temp_directory;
+    size_t calls = 0;
+    size_t limit = 0;
+    record_order by_name('\t', {{0, [&](std::string_view a, std::string_view b) {
+        if (++calls == limit) {
+            throw std::runtime_error("interrupted");
+        }
+        return a.compare(b);
+    }}});
+    merge_sorter(settings).sort_records_on_disk(reference, by_name);
+    settings.resumable = true;
+    limit = calls * 4 / 5;
+    calls = 0;
+    ASSERT_THROW(merge_sorter(settings).sort_records_on_disk(filename, by_name), std::runtime_error);
+    std::vector<std::filesystem::path> scratch(std::filesystem::directory_iterator(temp_directory), {});
+    ASSERT_EQ(1u, scratch.size());
+    std::optional<sort_manifest> checkpoint = sort_manifest::load((scratch[0] / "manifest").string());
+    ASSERT_TRUE(checkpoint.has_value());
+    ASSERT_GT(checkpoint->passes, 0u);
+
+    // Act: the same input sorted by number, the runs sorted by name must not be merged
+    record_order by_number('\t', {{1, record_order::numeric}});
+    merge_sorter(settings).sort_records_on_disk(filename, by_number);
+
+    // Assert
+    std::vector<std::string> expected(records);
+    std::stable_sort(expected.begin(), expected.end(), by_number);
+    std::ifstream input_file(filename, std::ios::binary);
+    std::vector<std::string> actual;
+    for (std::string line; std::getline(input_file, line);) {
+        actual.push_back(line);
+    }
+    ASSERT_EQ(expected, actual);
+    ASSERT_TRUE(std::filesystem::is_empty(temp_directory));
+
+    // Clean up
+    input_file.close();
+    remove(filename.c_str());
+    remove(reference.c_str());
+    std::filesystem::remove_all(temp_directory);
+}
+
+TEST(BlockCodecTest, TestRoundTripAndMalformedInput) {
+    // Arrange: repetitive, overlapping (runs of one byte), incompressible and tiny inputs
+    std::vector<std::string> inputs = {"", "a", std::string(1000, 'z'), "abcabcabcabcabcabcabcabcabcabcabcabc"};
+    std::string text;
+    for (int i = 0; i < 2000; i++) {
+        text += "token" + std::to_string(i % 37) + ' ';
+    }
+    inputs.push_back(text);
+    inputs.push_back(random_string(5000));
+
+    for (const auto& input : inputs) {
+        // Act
+        std::vector<char> packed(block_codec::max_compressed_size(input.size()));
+        size_t size = block_codec::compress(input.data(), input.size(), packed.data());
+        std::string output(input.size(), '\0');
+
+        // Assert
+        ASSERT_LE(size, packed.size());
+        ASSERT_TRUE(block_codec::decompress(packed.data(), size, output.data(), output.size()));
+        ASSERT_EQ(input, output);
+        if (!input.empty()) {
+            ASSERT_FALSE(block_codec::decompress(packed.data(), size, output.data(), output.size() - 1));
+        }
+    }
+    std::vector<char> packed(block_codec::max_compressed_size(text.size()));
+    ASSERT_LT(block_codec::compress(text.data(), text.size(), packed.data()), text.size() / 4);
+    std::string output(16, '\0');
+    ASSERT_FALSE(block_codec::decompress("\x0f\x01", 2, output.data(), output.size())); // match before the start
+}
+
+TEST(BinaryMergeBufferTest, TestCompressedRoundTripAcrossBlocks) {
+    // Arrange: sorted records share prefixes, so the blocks shrink
+    std::string filename = "binary_compressed.run";
+    std::vector<std::string> values = {"", std::string(300, 'x'), random_string(200)};
+    for (int i = 0; i < 2000; i++) {
+        values.push_back("record_" + std::to_string(100000 + i));
+    }
+    {
+        BinaryMergeWriter<std::string> writer(filename, 1024, true, 2, true);
+        for (const auto& value : values) {
+            writer.append(value);
+        }
+    }
+    size_t raw_bytes = 0;
+    for (const auto& value : values) {
+        raw_bytes += sizeof(std::uint32_t) + value.size();
+    }
+
+    // Act: both readers, the mapped one split into runs
+    std::vector<std::string> buffered;
+    BinaryMergeReader<std::string> reader(filename, 1024);
+    for (; !reader.is_exhausted(); reader.advance()) {
+        buffered.push_back(reader.get());
+    }
+    std::deque<size_t> lengths = {1, 700, 0, 1502};
+    MappedMergeReader<std::string_view> mapped(filename, 1024);
+    auto runs = mapped.split_runs(lengths);
+    std::vector<std::string> split;
+    for (auto& run : runs) {
+        for (; !run->is_exhausted(); run->advance()) {
+            split.emplace_back(run->get());
+        }
+    }
+
+    // Assert
+    ASSERT_EQ(values, buffered);
+    ASSERT_EQ(values, split);
+    ASSERT_LT(std::filesystem::file_size(filename), raw_bytes / 2);
+
+    // Clean up
+    runs.clear();
+    remove(filename.c_str());
+}
+
+TEST(MergeSortTest, TestCompressedRunsOnDisk) {
+    // Arrange
+    std::string filename = "compressed_runs_test_file_on_disk.txt";
+    file_manipulator::fill_randomly(filename, 50000, 6);
+    sort_digest input = sort_verifier::digest_tokens(filename);
+    merge_sorter::options settings;
+    settings.fan_in = 3;
+    settings.memory_budget = 65536;
+    settings.block_size = 4096;
+    settings.threads = 4;
+    settings.compress_runs = true;
+
+    // Act
+    merge_sorter(settings).sort_file_on_disk(filename);
+
+    // Assert
+    ASSERT_TRUE(sort_verifier::digest_tokens(filename).is_sorted_permutation_of(input));
+
+    // Clean up
+    remove(filename.c_str());
+}